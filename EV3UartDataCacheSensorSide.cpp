@@ -0,0 +1,86 @@
+/**
+ * \file EV3UartDataCacheSensorSide.cpp
+ *
+ * Definitions for the cache of pre-framed DATA messages
+ *
+ * \copyright Shenghao Yang, 2018
+ * 
+ * See LICENSE for details
+ */
+
+#include <EV3UartDataCacheSensorSide.hpp>
+#include <stdint.h>
+#include <string.h>
+
+namespace EV3UartProtocolParserSensorSide {
+
+using namespace EV3UartGenerator;
+
+uint8_t DataCache::data_offset(uint8_t mode) {
+	return (mode & 0x08) ? EXT_MODE_PREFIX_LEN : 0x00;
+}
+
+DataCache::DataCache() {
+
+}
+
+bool DataCache::set(uint8_t mode, const uint8_t* payload, uint8_t len) {
+	if ((mode >= DATA_CACHE_MODES) || (len == 0) || (len > 0x20))
+		return false;
+
+	const uint8_t length_code { Framing::log2(len) };
+	const uint8_t payload_length { two_pow(length_code) };
+	const uint8_t prefix { data_offset(mode) };
+	uint8_t* const target { frames[mode] + prefix };
+
+	if (prefix) {	// CMD EXT_MODE message carrying the offset of 8
+		frames[mode][0] = (static_cast<uint8_t>(Magics::CMD::CMD_BASE)
+						   | CMD_EXT_MODE);
+		frames[mode][1] = (mode & 0x08);
+		frames[mode][2] = Framing::checksum(frames[mode], 2);
+	}
+
+	target[0] = (static_cast<uint8_t>(Magics::DATA::DATA_BASE)
+				 | (length_code << 0x03) | (mode & 0x07));
+	memcpy(target + 1, payload, len);
+	memset(target + 1 + len, 0x00, payload_length - len);
+	target[payload_length + 1] = Framing::checksum(target,
+												   payload_length + 1);
+	frame_lengths[mode] = (prefix + payload_length + 2); // + header + FCS
+	return true;
+}
+
+bool DataCache::update(uint8_t mode, uint8_t offset, const uint8_t* values,
+					   uint8_t len) {
+	if ((mode >= DATA_CACHE_MODES) || (!frame_lengths[mode]))
+		return false;
+
+	uint8_t* const data { frames[mode] + data_offset(mode) };
+	const uint8_t payload_length { static_cast<uint8_t>(
+			frame_lengths[mode] - data_offset(mode) - 2) };
+	if ((offset > payload_length) || (len > (payload_length - offset)))
+		return false;
+
+	uint8_t* const target { data + 1 + offset };
+	uint8_t fcs { data[payload_length + 1] };
+	for (uint8_t i = 0; i < len; i++) {
+		// FCS is the XOR of all bytes, swap the old byte for the new one
+		fcs ^= (target[i] ^ values[i]);
+		target[i] = values[i];
+	}
+	data[payload_length + 1] = fcs;
+	return true;
+}
+
+const uint8_t* DataCache::frame(uint8_t mode) const {
+	if (mode >= DATA_CACHE_MODES)
+		return nullptr;
+	return frames[mode];
+}
+
+uint8_t DataCache::frame_length(uint8_t mode) const {
+	if (mode >= DATA_CACHE_MODES)
+		return 0;
+	return frame_lengths[mode];
+}
+}
@@ -0,0 +1,137 @@
+/**
+ * \file EV3UartDataCacheSensorSide.hpp
+ *
+ * Header file for the cache of pre-framed DATA messages sent by the sensor
+ * in response to SYS NACK messages from the EV3
+ *
+ * \copyright Shenghao Yang, 2018
+ * 
+ * See LICENSE for details
+ */
+
+#ifndef EV3UARTDATACACHESENSORSIDE_HPP_
+#define EV3UARTDATACACHESENSORSIDE_HPP_
+
+#include <EV3UartProtocolParserSensorSide.hpp>
+
+namespace EV3UartProtocolParserSensorSide {
+
+/**
+ * Number of modes DataCache keeps a DATA message for, the number of modes
+ * Link::mode() can report.
+ *
+ * The mode of a DATA message is encoded in the lower three bits of its
+ * header byte. DATA messages for modes 8 - 15 are preceded by a CMD
+ * EXT_MODE message carrying the offset of \c 8.
+ */
+constexpr uint8_t DATA_CACHE_MODES { 16 };
+
+/**
+ * Length of the CMD EXT_MODE message preceding the DATA messages for
+ * modes 8 - 15: header byte, offset and FCS byte
+ */
+constexpr uint8_t EXT_MODE_PREFIX_LEN { 3 };
+
+/**
+ * Cache holding the latest reading of each mode as a complete DATA message,
+ * framed and checksummed, ready to be written to the UART in one go when
+ * the EV3 sends a SYS NACK message. For modes 8 - 15, the CMD EXT_MODE
+ * message the EV3 expects before the DATA message is part of the frame.
+ *
+ * Readings are framed once by set(). Readings that change partially can be
+ * patched with update(), which adjusts the FCS incrementally instead of
+ * framing the message again.
+ * \code{.cpp}
+ * DataCache c { };
+ * c.set(0, reading, sizeof(reading));
+ * ...
+ * if (r.event == LinkEvent::SEND_DATA)
+ *     uart_write(c.frame(l.mode()), c.frame_length(l.mode()));
+ * \endcode
+ */
+class DataCache {
+private:
+	/**
+	 * DATA message for each mode, following the CMD EXT_MODE message for
+	 * modes 8 - 15.
+	 *
+	 * With \c prefix being data_offset(mode):
+	 * \c frames[mode][prefix] stores the header byte
+	 * \c frames[mode][prefix + 1] stores the first byte of the payload
+	 * \c frames[mode][prefix + payload_length + 1] stores the FCS byte
+	 */
+	uint8_t frames[DATA_CACHE_MODES][BUFFER_LEN + EXT_MODE_PREFIX_LEN];
+	/**
+	 * Length of the DATA message for each mode, \c 0 if no reading has been
+	 * set for that mode
+	 */
+	uint8_t frame_lengths[DATA_CACHE_MODES] = { };
+
+	/**
+	 * Obtain the offset of the DATA message in the frame for a mode
+	 *
+	 * @param mode mode, in the range [0, 15]
+	 * @return \ref EXT_MODE_PREFIX_LEN for modes 8 - 15, \c 0 otherwise
+	 */
+	static uint8_t data_offset(uint8_t mode);
+public:
+	DataCache();
+	DataCache(const DataCache&) = delete;
+
+	/**
+	 * Set the reading for a mode, framing a new DATA message
+	 *
+	 * The payload is padded with zeroes to the next power of two.
+	 *
+	 * @param mode mode the reading belongs to, in the range [0, 15]
+	 * @param payload pointer to the reading
+	 * @param len length of the reading, in the range [1, 32]
+	 * @retval true the DATA message was framed
+	 * @retval false \c mode or \c len are out of range, the cache was not
+	 * modified
+	 */
+	bool set(uint8_t mode, const uint8_t* payload, uint8_t len);
+
+	/**
+	 * Patch part of the reading for a mode, updating the FCS of the
+	 * already framed DATA message incrementally
+	 *
+	 * @pre set() was called successfully for \c mode
+	 *
+	 * @param mode mode the reading belongs to, in the range [0, 15]
+	 * @param offset offset of the first byte to patch, from the start of
+	 * the reading
+	 * @param values pointer to the new values of the bytes to patch
+	 * @param len number of bytes to patch
+	 * @retval true the DATA message was patched
+	 * @retval false \c mode is out of range, no reading was set for
+	 * \c mode, or the bytes to patch extend beyond the payload of the DATA
+	 * message. The cache was not modified.
+	 */
+	bool update(uint8_t mode, uint8_t offset, const uint8_t* values,
+				uint8_t len);
+
+	/**
+	 * Obtain a pointer to the DATA message for a mode, preceded by a CMD
+	 * EXT_MODE message for modes 8 - 15
+	 *
+	 * @param mode mode to obtain the DATA message for, in the range [0, 15]
+	 * @return pointer to the DATA message, or \c nullptr if \c mode is
+	 * out of range
+	 */
+	const uint8_t* frame(uint8_t mode) const;
+
+	/**
+	 * Obtain the length of the DATA message for a mode
+	 *
+	 * @param mode mode to obtain the DATA message length for, in the range
+	 * [0, 15]
+	 * @return length of the DATA message, including any CMD EXT_MODE
+	 * message preceding it, in bytes, or \c 0 if \c mode is
+	 * out of range or no reading was set for \c mode
+	 */
+	uint8_t frame_length(uint8_t mode) const;
+};
+}
+
+#endif /* EV3UARTDATACACHESENSORSIDE_HPP_ */
@@ -0,0 +1,106 @@
+/**
+ * \file EV3UartLinkQualitySensorSide.cpp
+ *
+ * Definitions for the link quality estimator and policy
+ *
+ * \copyright Shenghao Yang, 2018
+ * 
+ * See LICENSE for details
+ */
+
+#include <EV3UartLinkQualitySensorSide.hpp>
+#include <stdint.h>
+
+namespace EV3UartProtocolParserSensorSide {
+
+LinkQuality::LinkQuality() {
+
+}
+
+void LinkQuality::update(ParseResult res, size_t bytes) {
+	// Every byte is a sample of the invalid header rate, only the last
+	// byte can have been an invalid header byte. Bytes beyond the window
+	// length would only be evicted again.
+	if (bytes) {
+		const size_t valid { bytes - 0x01 };
+		for (size_t i = 0; (i < valid) && (i < HEADER_WINDOW_LEN); i++)
+			record_header(false);
+		record_header(res == ParseResult::RECEIVED_INVALID_HEADER);
+	}
+
+	switch (res) {
+	case ParseResult::RECEIVED_CMD_INVALID_FCS:
+		fcs_rate -= (fcs_rate >> FCS_RATE_SHIFT);
+		fcs_rate += (RATE_ONE >> FCS_RATE_SHIFT);
+		break;
+	case ParseResult::RECEIVED_CMD_SELECT:
+	case ParseResult::RECEIVED_CMD_WRITE:
+	case ParseResult::RECEIVED_CMD_SPEED:
+	case ParseResult::RECEIVED_CMD_EXT_MODE:
+		fcs_rate -= (fcs_rate >> FCS_RATE_SHIFT);
+		break;
+	default:
+		break;
+	}
+
+	if ((UINT32_MAX - bytes_observed) < bytes)
+		bytes_observed = UINT32_MAX;
+	else
+		bytes_observed += bytes;
+}
+
+void LinkQuality::record_header(bool invalid) {
+	const uint8_t mask { static_cast<uint8_t>(1u << (header_position & 0x07)) };
+	uint8_t& slot { header_window[header_position >> 3] };
+
+	if (slot & mask)
+		header_count -= 1;
+	if (invalid) {
+		slot |= mask;
+		header_count += 1;
+	} else {
+		slot &= static_cast<uint8_t>(~mask);
+	}
+
+	header_position = (header_position + 1) % HEADER_WINDOW_LEN;
+}
+
+uint32_t LinkQuality::invalid_header_rate() const {
+	// Until the window has filled, the rate is over the bytes observed so
+	// far rather than over the whole window
+	const uint32_t window {
+		(bytes_observed < HEADER_WINDOW_LEN) ? bytes_observed
+											 : HEADER_WINDOW_LEN
+	};
+	return window ? ((header_count * RATE_ONE) / window) : 0;
+}
+
+uint32_t LinkQuality::invalid_fcs_rate() const {
+	return fcs_rate;
+}
+
+uint32_t LinkQuality::observed() const {
+	return bytes_observed;
+}
+
+void LinkQuality::reset() {
+	for (uint8_t& slot : header_window)
+		slot = 0;
+	header_position = 0;
+	header_count = 0;
+	fcs_rate = 0;
+	bytes_observed = 0;
+}
+
+LinkAction LinkPolicy::evaluate(const LinkQuality& q) const {
+	if (q.observed() < min_observed)
+		return LinkAction::NONE;
+	if (q.invalid_header_rate() >= misclocked_header_rate)
+		return LinkAction::DROP_SPEED;
+	if (q.invalid_fcs_rate() >= restart_fcs_rate)
+		return LinkAction::RESTART_HANDSHAKE;
+	if (q.invalid_fcs_rate() >= reset_fcs_rate)
+		return LinkAction::RESET_PARSER;
+	return LinkAction::NONE;
+}
+}
@@ -0,0 +1,202 @@
+/**
+ * \file EV3UartLinkQualitySensorSide.hpp
+ *
+ * Header file for the link quality estimator and the policy acting on
+ * its estimates
+ *
+ * \copyright Shenghao Yang, 2018
+ * 
+ * See LICENSE for details
+ */
+
+#ifndef EV3UARTLINKQUALITYSENSORSIDE_HPP_
+#define EV3UARTLINKQUALITYSENSORSIDE_HPP_
+
+#include <EV3UartProtocolParserSensorSide.hpp>
+
+namespace EV3UartProtocolParserSensorSide {
+
+/**
+ * Rate representing certainty (100%), in the fixed point format used by
+ * LinkQuality
+ */
+constexpr uint32_t RATE_ONE { 0x10000 };
+
+/**
+ * Converts a percentage to a rate in the fixed point format used by
+ * LinkQuality
+ *
+ * @param pct percentage, in the range [0, 100]
+ * @return rate, in the range [0, \ref RATE_ONE]
+ */
+constexpr uint32_t rate_from_percent(uint8_t pct) {
+	return ((RATE_ONE * pct) / 100);
+}
+
+/**
+ * Number of most recent bytes the invalid header rate is counted over
+ */
+constexpr uint16_t HEADER_WINDOW_LEN { 256 };
+
+/**
+ * Shift applied to the per-message invalid FCS rate average. The average
+ * spans roughly \c 2^shift CMD messages (16).
+ */
+constexpr uint8_t FCS_RATE_SHIFT { 4 };
+
+/**
+ * Estimator of the quality of the line from the EV3, maintaining:
+ * - The fraction of the last \ref HEADER_WINDOW_LEN bytes that were
+ *   reported as invalid header bytes, counted exactly over a sliding window.
+ *   A high rate indicates that the UART is not running at the EV3's baud
+ *   rate.
+ * - An exponentially weighted moving average of the fraction of CMD
+ *   messages that were reported with invalid FCS. A high rate indicates a
+ *   noisy line.
+ *
+ * Rates are in fixed point, with \ref RATE_ONE representing 100%.
+ */
+class LinkQuality {
+private:
+	/**
+	 * Sliding window of the last \ref HEADER_WINDOW_LEN bytes, one bit per
+	 * byte, set if the byte was an invalid header byte
+	 */
+	uint8_t header_window[HEADER_WINDOW_LEN / 8] = { };
+	/**
+	 * Index of the bit in \ref header_window the next byte is recorded in
+	 */
+	uint16_t header_position = 0;
+	/**
+	 * Number of bits set in \ref header_window
+	 */
+	uint16_t header_count = 0;
+	/**
+	 * Moving average of the invalid FCS rate, see \ref FCS_RATE_SHIFT
+	 */
+	uint32_t fcs_rate = 0;
+	/**
+	 * Bytes observed, saturating at \c UINT32_MAX; caps the window denominator
+	 */
+	uint32_t bytes_observed = 0;
+
+	/**
+	 * Record one byte in the invalid header window, evicting the oldest
+	 *
+	 * @param invalid whether the byte was an invalid header byte
+	 */
+	void record_header(bool invalid);
+public:
+	LinkQuality();
+
+	/**
+	 * Update the estimates with the result of parsing a number of bytes
+	 *
+	 * @param res result of parsing the last of the bytes, all bytes
+	 * before it must have been reported as ParseResult::INSUFFICIENT_DATA,
+	 * as is the case for Parser::update(const uint8_t*, size_t, ParserReturn&)
+	 * @param bytes number of bytes parsed
+	 */
+	void update(ParseResult res, size_t bytes);
+
+	/**
+	 * Obtain the invalid header rate over the last \ref HEADER_WINDOW_LEN
+	 * bytes, or over all bytes observed if fewer bytes have been observed
+	 *
+	 * @return rate, in the range [0, \ref RATE_ONE]
+	 */
+	uint32_t invalid_header_rate() const;
+
+	/**
+	 * Obtain the invalid FCS rate, averaged over roughly the last 16
+	 * CMD messages
+	 *
+	 * @return rate, in the range [0, \ref RATE_ONE]
+	 */
+	uint32_t invalid_fcs_rate() const;
+
+	/**
+	 * Obtain the number of bytes observed since construction or the last
+	 * call to reset(), saturating at the maximum value of the return type
+	 *
+	 * @return number of bytes observed
+	 */
+	uint32_t observed() const;
+
+	/**
+	 * Reset the estimates, e.g. after acting on them
+	 */
+	void reset();
+};
+
+/**
+ * Enumeration listing the actions LinkPolicy can require on a link
+ */
+enum class LinkAction : uint8_t {
+	/**
+	 * The link is healthy
+	 */
+	NONE,
+	/**
+	 * The line is noisy, the parser state should be reset with
+	 * Parser::reset_state()
+	 */
+	RESET_PARSER,
+	/**
+	 * The line is too noisy to be recovered by resetting the parser, the
+	 * handshake should be restarted
+	 */
+	RESTART_HANDSHAKE,
+	/**
+	 * The UART is not running at the EV3's baud rate, a lower baud rate
+	 * should be used
+	 */
+	DROP_SPEED,
+};
+
+/**
+ * Thresholds deciding on the action to take on a link, from the estimates of
+ * a LinkQuality.
+ *
+ * Rates are in the fixed point format used by LinkQuality.
+ */
+struct LinkPolicy {
+	/**
+	 * Invalid header rate at or above which the link is considered to be
+	 * mis-clocked
+	 */
+	uint32_t misclocked_header_rate;
+	/**
+	 * Invalid FCS rate at or above which the handshake is restarted
+	 */
+	uint32_t restart_fcs_rate;
+	/**
+	 * Invalid FCS rate at or above which the parser is reset
+	 */
+	uint32_t reset_fcs_rate;
+	/**
+	 * Number of bytes that must be observed before any action is taken
+	 */
+	uint32_t min_observed;
+
+	/**
+	 * Evaluate the estimates of a link
+	 *
+	 * @param q estimates of the link
+	 * @return action to take on the link. LinkAction::DROP_SPEED takes
+	 * precedence over LinkAction::RESTART_HANDSHAKE, which takes precedence
+	 * over LinkAction::RESET_PARSER.
+	 */
+	LinkAction evaluate(const LinkQuality& q) const;
+};
+
+/**
+ * Default thresholds: the link is mis-clocked when 30% of the last 256 bytes
+ * were invalid header bytes
+ */
+constexpr LinkPolicy DEFAULT_LINK_POLICY {
+	rate_from_percent(30), rate_from_percent(50), rate_from_percent(25), 256
+};
+}
+
+#endif /* EV3UARTLINKQUALITYSENSORSIDE_HPP_ */
@@ -0,0 +1,192 @@
+/**
+ * \file EV3UartLinkSensorSide.cpp
+ *
+ * Definitions for the sensor-side EV3 UART link engine
+ *
+ * \copyright Shenghao Yang, 2018
+ * 
+ * See LICENSE for details
+ */
+
+#include <EV3UartLinkSensorSide.hpp>
+#include <stdint.h>
+
+namespace EV3UartProtocolParserSensorSide {
+
+namespace {
+
+/**
+ * Standard baud rates the data speed is stepped down through, fastest first
+ */
+constexpr uint32_t DATA_SPEEDS[] {
+	460800, 230400, 115200, 57600, 38400, 19200, 9600, 4800, 2400
+};
+}
+
+Link::Link(const uint8_t* burst, size_t burst_length, uint32_t data_speed)
+	: handshake_burst { burst }, handshake_burst_length { burst_length },
+	  link_data_speed { data_speed } {
+
+}
+
+const uint8_t* Link::handshake() const {
+	return handshake_burst;
+}
+
+size_t Link::handshake_length() const {
+	return handshake_burst_length;
+}
+
+void Link::set_handshake(const uint8_t* burst, size_t burst_length) {
+	handshake_burst = burst;
+	handshake_burst_length = burst_length;
+}
+
+uint32_t Link::data_speed() const {
+	return link_data_speed;
+}
+
+void Link::handshake_sent() {
+	link_parser.reset_state();
+	link_quality.reset();
+	current_mode = 0;
+	current_state = LinkState::WAIT_ACK;
+	state_entered = true;
+}
+
+size_t Link::update(const uint8_t* input, size_t len, LinkReturn& rtn) {
+	const size_t consumed { link_parser.update(input, len, rtn.msg) };
+	link_quality.update(rtn.msg.res, consumed);
+	rtn.event = LinkEvent::NONE;
+	if (consumed)
+		activity = true;
+
+	switch (current_state) {
+	case LinkState::WAIT_ACK:
+		if (rtn.msg.res == ParseResult::RECEIVED_SYS_ACK) {
+			current_state = LinkState::DATA;
+			state_entered = true;
+			rtn.event = LinkEvent::SWITCH_SPEED;
+		}
+		break;
+	case LinkState::STALLED:
+		if (consumed)
+			current_state = LinkState::DATA;
+		// Fall through
+	case LinkState::DATA:
+		switch (rtn.msg.res) {
+		case ParseResult::RECEIVED_SYS_NACK:
+			rtn.event = LinkEvent::SEND_DATA;
+			break;
+		case ParseResult::RECEIVED_CMD_SELECT:
+			current_mode = link_parser.selected_mode();
+			break;
+		default:
+			break;
+		}
+		break;
+	case LinkState::HANDSHAKE:
+		break;
+	}
+
+	return consumed;
+}
+
+LinkEvent Link::tick(uint32_t now, const LinkTimeouts& timeouts,
+					 const LinkPolicy& policy) {
+	if (state_entered) {
+		state_entered = false;
+		state_since = now;
+		last_activity = now;
+	}
+	if (activity) {
+		activity = false;
+		last_activity = now;
+	}
+
+	switch (current_state) {
+	case LinkState::HANDSHAKE:
+		break;
+	case LinkState::WAIT_ACK:
+		if ((now - state_since) >= timeouts.handshake)
+			return restart();
+		break;
+	case LinkState::DATA:
+	case LinkState::STALLED:
+		if ((now - last_activity) >= timeouts.disconnect)
+			return restart();
+
+		switch (policy.evaluate(link_quality)) {
+		case LinkAction::DROP_SPEED:
+			return drop_speed();
+		case LinkAction::RESTART_HANDSHAKE:
+			return restart();
+		case LinkAction::RESET_PARSER:
+			link_parser.reset_state();
+			link_quality.reset();
+			break;
+		case LinkAction::NONE:
+			break;
+		}
+
+		if ((current_state == LinkState::DATA)
+			&& ((now - last_activity) >= timeouts.stall)) {
+			current_state = LinkState::STALLED;
+			return LinkEvent::STALLED;
+		}
+		break;
+	}
+
+	return LinkEvent::NONE;
+}
+
+LinkEvent Link::restart() {
+	reset();
+	return LinkEvent::RESTART_HANDSHAKE;
+}
+
+LinkEvent Link::drop_speed() {
+	for (const uint32_t speed : DATA_SPEEDS) {
+		if (speed < link_data_speed) {
+			reset();
+			link_data_speed = speed;
+			return LinkEvent::DROP_SPEED;
+		}
+	}
+
+	return restart();
+}
+
+LinkState Link::state() const {
+	return current_state;
+}
+
+uint8_t Link::mode() const {
+	return current_mode;
+}
+
+Parser& Link::parser() {
+	return link_parser;
+}
+
+const Parser& Link::parser() const {
+	return link_parser;
+}
+
+LinkQuality& Link::quality() {
+	return link_quality;
+}
+
+const LinkQuality& Link::quality() const {
+	return link_quality;
+}
+
+void Link::reset() {
+	link_parser.reset_state();
+	link_quality.reset();
+	current_state = LinkState::HANDSHAKE;
+	current_mode = 0;
+	activity = false;
+	state_entered = false;
+}
+}
@@ -0,0 +1,358 @@
+/**
+ * \file EV3UartLinkSensorSide.hpp
+ *
+ * Header file for the sensor-side EV3 UART link engine, which sequences
+ * the handshake with the EV3 around the
+ * EV3UartProtocolParserSensorSide::Parser
+ *
+ * \copyright Shenghao Yang, 2018
+ * 
+ * See LICENSE for details
+ */
+
+#ifndef EV3UARTLINKSENSORSIDE_HPP_
+#define EV3UARTLINKSENSORSIDE_HPP_
+
+#include <EV3UartProtocolParserSensorSide.hpp>
+#include <EV3UartLinkQualitySensorSide.hpp>
+
+namespace EV3UartProtocolParserSensorSide {
+
+/**
+ * Enumeration listing the states the link state machine can be in
+ */
+enum class LinkState : uint8_t {
+	/**
+	 * Handshake burst has not been sent yet, the link is disconnected
+	 */
+	HANDSHAKE,
+	/**
+	 * Handshake burst has been sent, the link is waiting for the
+	 * SYS ACK message from the EV3
+	 */
+	WAIT_ACK,
+	/**
+	 * Handshake is complete, the link is in data mode
+	 */
+	DATA,
+	/**
+	 * Link is in data mode, but nothing has been received from the EV3 for
+	 * longer than LinkTimeouts::stall. Returns to LinkState::DATA as soon as
+	 * data is received.
+	 */
+	STALLED,
+};
+
+/**
+ * Enumeration listing the events the link requires the application to act
+ * on, returned by Link
+ */
+enum class LinkEvent : uint8_t {
+	/**
+	 * No action is required
+	 */
+	NONE,
+	/**
+	 * The EV3 acknowledged the handshake. The UART must be switched to
+	 * Link::data_speed() before anything else is sent to the EV3.
+	 */
+	SWITCH_SPEED,
+	/**
+	 * The EV3 requested data with a SYS NACK message while the link is in
+	 * data mode. The DATA message for Link::mode() should be sent, e.g.
+	 * from a DataCache.
+	 */
+	SEND_DATA,
+	/**
+	 * The link has been reset, because the EV3 did not acknowledge the
+	 * handshake in time, went silent, or the line is unusable. The UART
+	 * must be switched back to the handshake baud rate (2400), and the
+	 * handshake burst sent again.
+	 */
+	RESTART_HANDSHAKE,
+	/**
+	 * The link entered LinkState::STALLED
+	 */
+	STALLED,
+	/**
+	 * The line from the EV3 is mis-clocked at the data speed. The link has
+	 * been reset, and Link::data_speed() stepped down to the next lower
+	 * standard baud rate. As for LinkEvent::RESTART_HANDSHAKE, the UART
+	 * must be switched back to the handshake baud rate (2400), and the
+	 * handshake burst sent again, after replacing it with one advertising
+	 * the new data speed in its CMD SPEED message through
+	 * Link::set_handshake().
+	 */
+	DROP_SPEED,
+};
+
+/**
+ * Timeouts driving the link lifecycle in Link::tick(), in the same unit as
+ * the timestamps passed to that function
+ */
+struct LinkTimeouts {
+	/**
+	 * Time the EV3 has to acknowledge the handshake burst before the
+	 * handshake is restarted
+	 */
+	uint32_t handshake;
+	/**
+	 * Silence in data mode after which the link is considered stalled
+	 */
+	uint32_t stall;
+	/**
+	 * Silence in data mode after which the EV3 is considered disconnected,
+	 * and the handshake is restarted
+	 */
+	uint32_t disconnect;
+};
+
+/**
+ * Default timeouts, in milliseconds. The EV3 sends a SYS NACK message
+ * roughly every 100 ms in data mode.
+ */
+constexpr LinkTimeouts DEFAULT_LINK_TIMEOUTS { 500, 250, 1000 };
+
+/**
+ * Structure returned by the Link::update() function.
+ */
+struct LinkReturn {
+	ParserReturn msg;	///< Parsing information for the last byte consumed
+	LinkEvent event;	///< Event the application has to act on
+};
+
+/**
+ * Link engine for the sensor side of an EV3 UART connection.
+ *
+ * The handshake burst (CMD TYPE, CMD MODES, CMD SPEED, INFO messages,
+ * terminated by a SYS ACK message) is framed once by the application, using
+ * the EV3UartGenerator::Framing functions, into a buffer that outlives the
+ * link. The link hands that burst out to be written back-to-back, parses the
+ * EV3's messages, and reports LinkEvent::SWITCH_SPEED as soon as the EV3's
+ * SYS ACK message is parsed.
+ * \code{.cpp}
+ * Link l { burst, burst_len, 115200 };
+ * uart_write(l.handshake(), l.handshake_length());
+ * l.handshake_sent();
+ * ...
+ * LinkReturn r { };
+ * block += l.update(block, len, r);
+ * if (r.event == LinkEvent::SWITCH_SPEED)
+ *     uart_set_speed(l.data_speed());
+ * \endcode
+ *
+ * The lifecycle of the link is driven by calling tick() periodically from the
+ * same loop that feeds it data. The link restarts the handshake when the EV3
+ * does not acknowledge it in time, goes silent (e.g. when it is unplugged),
+ * or when the line quality calls for it:
+ * \code{.cpp}
+ * if (l.tick(millis()) == LinkEvent::RESTART_HANDSHAKE) {
+ *     uart_set_speed(2400);
+ *     uart_write(l.handshake(), l.handshake_length());
+ *     l.handshake_sent();
+ * }
+ * \endcode
+ *
+ * The link estimates the quality of the line from the EV3 as it parses, and
+ * tick() evaluates the estimates against a LinkPolicy. On a mis-clocked line,
+ * the link steps its data speed down, and the burst has to be framed again
+ * with the lower speed:
+ * \code{.cpp}
+ * if (l.tick(millis()) == LinkEvent::DROP_SPEED) {
+ *     burst_len = frame_burst(burst, l.data_speed());
+ *     l.set_handshake(burst, burst_len);
+ *     uart_set_speed(2400);
+ *     uart_write(l.handshake(), l.handshake_length());
+ *     l.handshake_sent();
+ * }
+ * \endcode
+ */
+class Link {
+private:
+	Parser link_parser;
+	LinkQuality link_quality;
+	const uint8_t* handshake_burst;
+	size_t handshake_burst_length;
+	uint32_t link_data_speed;
+	LinkState current_state = LinkState::HANDSHAKE;
+	uint8_t current_mode = 0;
+	/**
+	 * \c true if bytes were received since the last call to tick()
+	 */
+	bool activity = false;
+	/**
+	 * \c true if the state changed since the last call to tick()
+	 */
+	bool state_entered = false;
+	/**
+	 * Timestamp of the first call to tick() in the current state
+	 */
+	uint32_t state_since = 0;
+	/**
+	 * Timestamp of the last call to tick() with bytes received before it
+	 */
+	uint32_t last_activity = 0;
+
+	/**
+	 * Reset the link and raise LinkEvent::RESTART_HANDSHAKE
+	 *
+	 * @return LinkEvent::RESTART_HANDSHAKE
+	 */
+	LinkEvent restart();
+
+	/**
+	 * Reset the link and step the data speed down, raising
+	 * LinkEvent::DROP_SPEED, or LinkEvent::RESTART_HANDSHAKE if the data
+	 * speed cannot be lowered any further
+	 *
+	 * @return event raised
+	 */
+	LinkEvent drop_speed();
+public:
+	/**
+	 * Construct a link
+	 *
+	 * @param burst pointer to the pre-framed handshake burst. The burst is
+	 * not copied, and must remain valid for the lifetime of the link.
+	 * @param burst_length length of the handshake burst, in bytes
+	 * @param data_speed baud rate to switch to once the EV3 acknowledges the
+	 * handshake, usually the baud rate sent in the burst's CMD SPEED message
+	 */
+	Link(const uint8_t* burst, size_t burst_length, uint32_t data_speed);
+	Link(const Link&) = delete;
+
+	/**
+	 * Obtain a pointer to the pre-framed handshake burst
+	 *
+	 * @return pointer to the handshake burst
+	 */
+	const uint8_t* handshake() const;
+
+	/**
+	 * Obtain the length of the pre-framed handshake burst
+	 *
+	 * @return length of the handshake burst, in bytes
+	 */
+	size_t handshake_length() const;
+
+	/**
+	 * Replace the pre-framed handshake burst, e.g. with one advertising
+	 * the lowered data_speed() after LinkEvent::DROP_SPEED
+	 *
+	 * @param burst pointer to the pre-framed handshake burst. The burst is
+	 * not copied, and must remain valid for the lifetime of the link.
+	 * @param burst_length length of the handshake burst, in bytes
+	 */
+	void set_handshake(const uint8_t* burst, size_t burst_length);
+
+	/**
+	 * Obtain the baud rate to be used in data mode
+	 *
+	 * @return baud rate, in bits per second. Lowered on
+	 * LinkEvent::DROP_SPEED.
+	 */
+	uint32_t data_speed() const;
+
+	/**
+	 * Inform the link that the handshake burst has been written to the
+	 * UART, so that it starts waiting for the EV3's SYS ACK message.
+	 *
+	 * Any partially parsed message is discarded.
+	 */
+	void handshake_sent();
+
+	/**
+	 * Update the link with a block of information from the EV3
+	 *
+	 * The block is parsed with
+	 * Parser::update(const uint8_t*, size_t, ParserReturn&), so bytes are
+	 * consumed until a message is parsed or the block is exhausted.
+	 *
+	 * @param input pointer to the block of information from the EV3
+	 * @param len length of the block, in bytes
+	 * @param rtn \ref LinkReturn structure that receives the parsing
+	 * information and the event raised by the bytes consumed
+	 * @return number of bytes consumed from \c input
+	 */
+	size_t update(const uint8_t* input, size_t len, LinkReturn& rtn);
+
+	/**
+	 * Advance the lifecycle of the link
+	 *
+	 * Should be called periodically, e.g. on every iteration of the loop
+	 * calling update(). Silence is measured between calls, so the period
+	 * bounds the accuracy of the timeouts.
+	 *
+	 * In data mode, the line quality estimates are evaluated against
+	 * \c policy on each call: LinkAction::RESET_PARSER resets the parser,
+	 * LinkAction::RESTART_HANDSHAKE restarts the handshake, and
+	 * LinkAction::DROP_SPEED restarts it with a lower data speed.
+	 *
+	 * @param now current timestamp, from a monotonic clock that may wrap
+	 * around
+	 * @param timeouts timeouts to apply, in the unit of \c now
+	 * @param policy policy to evaluate the line quality against
+	 * @return LinkEvent::DROP_SPEED if the link was reset with a lower data
+	 * speed, LinkEvent::RESTART_HANDSHAKE if the link was reset otherwise,
+	 * LinkEvent::STALLED if the link stalled, LinkEvent::NONE otherwise
+	 */
+	LinkEvent tick(uint32_t now,
+				   const LinkTimeouts& timeouts = DEFAULT_LINK_TIMEOUTS,
+				   const LinkPolicy& policy = DEFAULT_LINK_POLICY);
+
+	/**
+	 * Obtain the current state of the link
+	 *
+	 * @return current state of the link
+	 */
+	LinkState state() const;
+
+	/**
+	 * Obtain the mode last selected by the EV3 with a CMD SELECT message
+	 * in data mode, including any CMD EXT_MODE offset.
+	 *
+	 * @return selected mode, \c 0 if the EV3 has not selected a mode since
+	 * the handshake
+	 */
+	uint8_t mode() const;
+
+	/**
+	 * Obtain the parser used by the link, e.g. to access the payload of a
+	 * parsed message through Parser::data()
+	 *
+	 * @return parser used by the link
+	 */
+	Parser& parser();
+
+	/**
+	 * Provides the same functionality as the similarly named function,
+	 * except that it returns a parser that cannot be modified.
+	 *
+	 * @return parser used by the link
+	 */
+	const Parser& parser() const;
+
+	/**
+	 * Obtain the estimates of the quality of the line from the EV3, updated
+	 * by update() and reset by handshake_sent() and reset()
+	 *
+	 * @return estimates of the line quality
+	 */
+	LinkQuality& quality();
+
+	/**
+	 * Provides the same functionality as the similarly named function,
+	 * except that it returns estimates that cannot be modified.
+	 *
+	 * @return estimates of the line quality
+	 */
+	const LinkQuality& quality() const;
+
+	/**
+	 * Reset the link, so that the handshake has to be sent again.
+	 */
+	void reset();
+};
+}
+
+#endif /* EV3UARTLINKSENSORSIDE_HPP_ */
@@ -0,0 +1,99 @@
+/**
+ * \file EV3UartMessagePoolSensorSide.cpp
+ *
+ * Definitions for the pool of reference-counted messages
+ *
+ * \copyright Shenghao Yang, 2018
+ * 
+ * See LICENSE for details
+ */
+
+#include <EV3UartMessagePoolSensorSide.hpp>
+#include <stdint.h>
+#include <string.h>
+
+namespace EV3UartProtocolParserSensorSide {
+
+static_assert(MESSAGE_POOL_SUBSCRIBERS <= 8,
+			  "Subscriber masks must fit in a uint8_t");
+static_assert(PARSE_RESULT_COUNT <= 16,
+			  "Result masks must fit in MessageFilter::results");
+
+MessagePool::MessagePool() {
+
+}
+
+bool MessagePool::subscribe(const MessageFilter& filter,
+							MessageCallback callback, void* context) {
+	if (subscriber_count >= MESSAGE_POOL_SUBSCRIBERS)
+		return false;
+
+	const uint8_t bit { static_cast<uint8_t>(0x01 << subscriber_count) };
+	subscribers[subscriber_count] = Subscriber { callback, context };
+	subscriber_count += 1;
+
+	for (uint8_t port = 0; port < MESSAGE_POOL_PORTS; port++)
+		if (filter.ports & (static_cast<uint32_t>(0x01) << port))
+			port_subscribers[port] |= bit;
+	for (uint8_t res = 0; res < PARSE_RESULT_COUNT; res++)
+		if (filter.results & (0x01 << res))
+			result_subscribers[res] |= bit;
+	return true;
+}
+
+bool MessagePool::publish(uint8_t port, const ParserReturn& rtn,
+						  const uint8_t* payload) {
+	if (port >= MESSAGE_POOL_PORTS)
+		return false;
+
+	const uint8_t matched { static_cast<uint8_t>(port_subscribers[port]
+		& result_subscribers[static_cast<uint8_t>(rtn.res)]) };
+	if (!matched)
+		return true;
+
+	MessageHandle handle { 0 };
+	while ((handle < MESSAGE_POOL_SLOTS) && references[handle])
+		handle++;
+	if (handle == MESSAGE_POOL_SLOTS) {
+		dropped_count += 1;
+		return false;
+	}
+
+	Message& msg { slots[handle] };
+	msg.port = port;
+	msg.info = rtn;
+	memcpy(msg.payload, payload, rtn.len);
+
+	// Publisher holds a reference while delivering
+	references[handle] = 1;
+	for (uint8_t i = 0; i < subscriber_count; i++)
+		if (matched & (0x01 << i))
+			subscribers[i].callback(subscribers[i].context, *this, handle);
+	release(handle);
+	return true;
+}
+
+void MessagePool::retain(MessageHandle handle) {
+	references[handle] += 1;
+}
+
+void MessagePool::release(MessageHandle handle) {
+	references[handle] -= 1;
+}
+
+const Message& MessagePool::message(MessageHandle handle) const {
+	return slots[handle];
+}
+
+uint8_t MessagePool::available() const {
+	uint8_t count { 0 };
+	for (uint8_t i = 0; i < MESSAGE_POOL_SLOTS; i++)
+		if (!references[i])
+			count++;
+	return count;
+}
+
+uint32_t MessagePool::dropped() const {
+	return dropped_count;
+}
+}
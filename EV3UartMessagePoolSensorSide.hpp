@@ -0,0 +1,219 @@
+/**
+ * \file EV3UartMessagePoolSensorSide.hpp
+ *
+ * Header file for the pool of reference-counted messages, fanned out to
+ * subscribers by filter
+ *
+ * \copyright Shenghao Yang, 2018
+ * 
+ * See LICENSE for details
+ */
+
+#ifndef EV3UARTMESSAGEPOOLSENSORSIDE_HPP_
+#define EV3UARTMESSAGEPOOLSENSORSIDE_HPP_
+
+#include <EV3UartProtocolParserSensorSide.hpp>
+
+namespace EV3UartProtocolParserSensorSide {
+
+/**
+ * Number of message slots in a MessagePool
+ */
+constexpr uint8_t MESSAGE_POOL_SLOTS { 16 };
+
+/**
+ * Maximum number of subscribers to a MessagePool
+ */
+constexpr uint8_t MESSAGE_POOL_SUBSCRIBERS { 8 };
+
+/**
+ * Number of ports a MessagePool accepts messages from, numbered from \c 0
+ */
+constexpr uint8_t MESSAGE_POOL_PORTS { 32 };
+
+/**
+ * Number of ParseResult values, ParseResult::RECEIVED_CMD_INVALID_FCS being
+ * the last one
+ */
+constexpr uint8_t PARSE_RESULT_COUNT {
+	static_cast<uint8_t>(ParseResult::RECEIVED_CMD_INVALID_FCS) + 1
+};
+
+/**
+ * Handle to a message in a MessagePool
+ */
+typedef uint8_t MessageHandle;
+
+/**
+ * Message stored in a MessagePool
+ */
+struct Message {
+	uint8_t port;				///< Port the message was received from
+	ParserReturn info;			///< Parsing information for the message
+	uint8_t payload[BUFFER_LEN - 1]; ///< Payload of the message, \c info.len bytes
+};
+
+/**
+ * Filter selecting the messages delivered to a subscriber
+ */
+struct MessageFilter {
+	/**
+	 * Ports accepted. Bit \c n is set if messages from port \c n are
+	 * accepted.
+	 */
+	uint32_t ports;
+	/**
+	 * Parsing results accepted. Bit \c n is set if messages with
+	 * ParserReturn::res equal to the ParseResult of value \c n are accepted.
+	 * See result_mask().
+	 */
+	uint16_t results;
+};
+
+/**
+ * Obtain the bit representing a parsing result in MessageFilter::results
+ *
+ * @param res parsing result
+ * @return bit representing \c res
+ */
+constexpr uint16_t result_mask(ParseResult res) {
+	return static_cast<uint16_t>(0x01 << static_cast<uint8_t>(res));
+}
+
+class MessagePool;
+
+/**
+ * Function called to deliver a message to a subscriber.
+ *
+ * The message stays valid for the duration of the call. To use it
+ * afterwards, the subscriber must call MessagePool::retain() on the handle
+ * during the call, and MessagePool::release() once done with it.
+ *
+ * @param context context pointer passed to MessagePool::subscribe()
+ * @param pool pool holding the message
+ * @param handle handle to the message
+ */
+typedef void (*MessageCallback)(void* context, MessagePool& pool,
+								MessageHandle handle);
+
+/**
+ * Fixed-capacity pool of messages, shared by reference count between the
+ * subscribers they are delivered to.
+ *
+ * Each message published is copied into a slot once, no matter how many
+ * subscribers it is delivered to. Filters are compiled into per-port and
+ * per-result subscriber masks when subscribing, so the subscribers of a
+ * message are found with a single AND.
+ * \code{.cpp}
+ * MessagePool pool { };
+ * pool.subscribe({ 0xffffffff, result_mask(ParseResult::RECEIVED_CMD_WRITE) },
+ *                on_write, &ctx);
+ * ...
+ * ParserReturn r { p.update(byte) };
+ * if (r.res != ParseResult::INSUFFICIENT_DATA)
+ *     pool.publish(port, r, p.data());
+ * \endcode
+ */
+class MessagePool {
+private:
+	/**
+	 * Subscriber registered with subscribe()
+	 */
+	struct Subscriber {
+		MessageCallback callback;
+		void* context;
+	};
+
+	Message slots[MESSAGE_POOL_SLOTS];
+	/**
+	 * Reference count of each slot, \c 0 if the slot is free
+	 */
+	uint8_t references[MESSAGE_POOL_SLOTS] = { };
+	Subscriber subscribers[MESSAGE_POOL_SUBSCRIBERS];
+	uint8_t subscriber_count = 0;
+	/**
+	 * Subscribers accepting messages from each port. Bit \c n is set if
+	 * subscriber \c n accepts messages from the port.
+	 */
+	uint8_t port_subscribers[MESSAGE_POOL_PORTS] = { };
+	/**
+	 * Subscribers accepting each parsing result, in the same format as
+	 * \ref port_subscribers
+	 */
+	uint8_t result_subscribers[PARSE_RESULT_COUNT] = { };
+	uint32_t dropped_count = 0;
+public:
+	MessagePool();
+	MessagePool(const MessagePool&) = delete;
+
+	/**
+	 * Register a subscriber
+	 *
+	 * @param filter filter selecting the messages delivered to the
+	 * subscriber
+	 * @param callback function called to deliver messages
+	 * @param context pointer passed to \c callback
+	 * @return \c true if the subscriber was registered, \c false if the
+	 * maximum number of subscribers is already registered
+	 */
+	bool subscribe(const MessageFilter& filter, MessageCallback callback,
+				   void* context);
+
+	/**
+	 * Publish a message, delivering it to every subscriber whose filter
+	 * accepts it, in the order they subscribed
+	 *
+	 * @param port port the message was received from, in the range
+	 * [0, MESSAGE_POOL_PORTS)
+	 * @param rtn parsing information for the message, as returned by
+	 * Parser::update()
+	 * @param payload payload of the message, as returned by Parser::data()
+	 * @return \c true if the message was delivered to its subscribers, or
+	 * had none. \c false if \c port is out of range, or if the message had
+	 * subscribers but no slot was free, in which case it is counted as
+	 * dropped.
+	 */
+	bool publish(uint8_t port, const ParserReturn& rtn,
+				 const uint8_t* payload);
+
+	/**
+	 * Take a reference to a message, keeping it valid until release() is
+	 * called
+	 *
+	 * @param handle handle to the message
+	 */
+	void retain(MessageHandle handle);
+
+	/**
+	 * Drop a reference to a message, taken with retain(). The slot is
+	 * freed when the last reference is dropped.
+	 *
+	 * @param handle handle to the message
+	 */
+	void release(MessageHandle handle);
+
+	/**
+	 * Obtain a message
+	 *
+	 * @param handle handle to the message
+	 * @return message
+	 */
+	const Message& message(MessageHandle handle) const;
+
+	/**
+	 * Obtain the number of free slots
+	 *
+	 * @return number of free slots
+	 */
+	uint8_t available() const;
+
+	/**
+	 * Obtain the number of messages dropped because no slot was free
+	 *
+	 * @return number of messages dropped
+	 */
+	uint32_t dropped() const;
+};
+}
+
+#endif /* EV3UARTMESSAGEPOOLSENSORSIDE_HPP_ */
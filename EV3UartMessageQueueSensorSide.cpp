@@ -0,0 +1,97 @@
+/**
+ * \file EV3UartMessageQueueSensorSide.cpp
+ *
+ * Definitions for the bounded queue of messages
+ *
+ * \copyright Shenghao Yang, 2018
+ * 
+ * See LICENSE for details
+ */
+
+#include <EV3UartMessageQueueSensorSide.hpp>
+#include <stdint.h>
+#include <string.h>
+
+namespace EV3UartProtocolParserSensorSide {
+
+MessageQueue::MessageQueue(OverflowPolicy policy)
+	: overflow_policy { policy } {
+
+}
+
+uint8_t MessageQueue::index(uint8_t position) const {
+	return ((oldest + position) % MESSAGE_QUEUE_LEN);
+}
+
+bool MessageQueue::push(uint8_t port, const ParserReturn& rtn,
+						const uint8_t* payload) {
+	Message* target { nullptr };
+
+	if (queued < MESSAGE_QUEUE_LEN) {
+		target = &messages[index(queued)];
+		queued += 1;
+	} else {
+		switch (overflow_policy) {
+		case OverflowPolicy::REJECT:
+			break;
+		case OverflowPolicy::DROP_OLDEST:
+			// Oldest slot becomes the newest
+			target = &messages[oldest];
+			oldest = index(1);
+			stats.dropped_oldest += 1;
+			break;
+		case OverflowPolicy::KEEP_LATEST:
+			for (uint8_t position = queued; position > 0; position--) {
+				const Message& candidate { messages[index(position - 1)] };
+				if ((candidate.port != port)
+					|| (candidate.info.res != rtn.res))
+					continue;
+
+				// Close the gap left by the replaced message, and queue
+				// the message at the back, keeping the order of delivery
+				for (; position < queued; position++)
+					messages[index(position - 1)] = messages[index(position)];
+				target = &messages[index(queued - 1)];
+				stats.replaced += 1;
+				break;
+			}
+			break;
+		}
+	}
+
+	if (!target) {
+		stats.rejected += 1;
+		return false;
+	}
+
+	target->port = port;
+	target->info = rtn;
+	memcpy(target->payload, payload, rtn.len);
+	return true;
+}
+
+bool MessageQueue::pop(Message& out) {
+	if (!queued)
+		return false;
+
+	const Message& source { messages[oldest] };
+	out.port = source.port;
+	out.info = source.info;
+	memcpy(out.payload, source.payload, source.info.len);
+	oldest = index(1);
+	queued -= 1;
+	return true;
+}
+
+uint8_t MessageQueue::size() const {
+	return queued;
+}
+
+bool MessageQueue::empty() const {
+	return (queued == 0);
+}
+
+const QueueStatistics& MessageQueue::statistics() const {
+	return stats;
+}
+}
@@ -0,0 +1,160 @@
+/**
+ * \file EV3UartMessageQueueSensorSide.hpp
+ *
+ * Header file for the bounded queue of messages between the parsing stage
+ * and the handling stage of an application
+ *
+ * \copyright Shenghao Yang, 2018
+ * 
+ * See LICENSE for details
+ */
+
+#ifndef EV3UARTMESSAGEQUEUESENSORSIDE_HPP_
+#define EV3UARTMESSAGEQUEUESENSORSIDE_HPP_
+
+#include <EV3UartProtocolParserSensorSide.hpp>
+#include <EV3UartMessagePoolSensorSide.hpp>
+
+namespace EV3UartProtocolParserSensorSide {
+
+/**
+ * Number of messages a MessageQueue holds
+ */
+constexpr uint8_t MESSAGE_QUEUE_LEN { 16 };
+
+/**
+ * Enumeration listing what a MessageQueue does with a message pushed while
+ * it is full
+ */
+enum class OverflowPolicy : uint8_t {
+	/**
+	 * The message is rejected, and MessageQueue::push() returns \c false.
+	 * The parsing stage can stop reading until there is room, pushing
+	 * back on the UART.
+	 */
+	REJECT,
+	/**
+	 * The oldest message in the queue is dropped to make room
+	 */
+	DROP_OLDEST,
+	/**
+	 * The newest message in the queue from the same port with the same
+	 * ParseResult is removed, and the message queued at the back, so that
+	 * it is still delivered after every message queued before it. If there
+	 * is no such message, the message is rejected.
+	 */
+	KEEP_LATEST,
+};
+
+/**
+ * Structure containing the number of messages a MessageQueue did not
+ * deliver because it was full
+ */
+struct QueueStatistics {
+	uint32_t rejected;		 ///< Messages rejected by MessageQueue::push()
+	uint32_t dropped_oldest; ///< Queued messages dropped to make room
+	uint32_t replaced;		 ///< Queued messages replaced by newer ones
+};
+
+/**
+ * Bounded queue of messages, decoupling the stage parsing messages from the
+ * stage handling them, so that a slow handler does not stall the parser and
+ * the UART.
+ *
+ * The parsing stage pushes each message it parses; the handling stage
+ * consumes them in order, copying each message out of the queue:
+ * \code{.cpp}
+ * MessageQueue q { OverflowPolicy::KEEP_LATEST };
+ * ...
+ * if (r.res != ParseResult::INSUFFICIENT_DATA)
+ *     q.push(port, r, p.data());
+ * ...
+ * Message m;
+ * while (q.pop(m))
+ *     handle(m);
+ * \endcode
+ *
+ * \warning The queue does no locking. If the stages run in different
+ * contexts (threads, or an interrupt handler and the main loop), calls
+ * must be serialized by the application, e.g. with a mutex or by disabling
+ * interrupts around them. As messages are copied out by pop(), the lock
+ * only needs to be held for the duration of push() and pop(), not while a
+ * message is handled.
+ */
+class MessageQueue {
+private:
+	Message messages[MESSAGE_QUEUE_LEN];
+	/**
+	 * Index in \ref messages of the oldest message, only advanced by pop(),
+	 * and by push() under OverflowPolicy::DROP_OLDEST
+	 */
+	uint8_t oldest = 0;
+	uint8_t queued = 0;
+	OverflowPolicy overflow_policy;
+	QueueStatistics stats = { };
+
+	/**
+	 * Obtain the index in \ref messages of a queued message
+	 *
+	 * @param position position of the message in the queue, \c 0 being the
+	 * oldest
+	 * @return index in \ref messages
+	 */
+	uint8_t index(uint8_t position) const;
+public:
+	/**
+	 * Construct a queue
+	 *
+	 * @param policy what to do with messages pushed while the queue is full
+	 */
+	explicit MessageQueue(OverflowPolicy policy);
+	MessageQueue(const MessageQueue&) = delete;
+
+	/**
+	 * Push a message at the back of the queue
+	 *
+	 * @param port port the message was received from
+	 * @param rtn parsing information for the message, as returned by
+	 * Parser::update()
+	 * @param payload payload of the message, as returned by Parser::data()
+	 * @return \c true if the message was queued, or replaced a queued
+	 * message. \c false if it was rejected.
+	 */
+	bool push(uint8_t port, const ParserReturn& rtn, const uint8_t* payload);
+
+	/**
+	 * Remove the oldest message from the queue, copying it out
+	 *
+	 * @param out structure receiving a copy of the oldest message. Only
+	 * the first \c out.info.len bytes of the payload are copied.
+	 * @retval true a message was removed from the queue, and copied to
+	 * \c out
+	 * @retval false the queue is empty, \c out was not modified
+	 */
+	bool pop(Message& out);
+
+	/**
+	 * Obtain the number of messages in the queue
+	 *
+	 * @return number of messages in the queue
+	 */
+	uint8_t size() const;
+
+	/**
+	 * Check whether the queue is empty
+	 *
+	 * @return \c true if the queue is empty
+	 */
+	bool empty() const;
+
+	/**
+	 * Obtain the number of messages not delivered because the queue was
+	 * full
+	 *
+	 * @return \ref QueueStatistics structure
+	 */
+	const QueueStatistics& statistics() const;
+};
+}
+
+#endif /* EV3UARTMESSAGEQUEUESENSORSIDE_HPP_ */
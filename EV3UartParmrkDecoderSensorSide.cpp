@@ -0,0 +1,69 @@
+/**
+ * \file EV3UartParmrkDecoderSensorSide.cpp
+ *
+ * Definitions for the decoder of termios \c PARMRK marked input
+ *
+ * \copyright Shenghao Yang, 2018
+ * 
+ * See LICENSE for details
+ */
+
+#include <EV3UartParmrkDecoderSensorSide.hpp>
+#include <stdint.h>
+
+namespace EV3UartProtocolParserSensorSide {
+
+ParmrkDecoder::ParmrkDecoder() {
+
+}
+
+size_t ParmrkDecoder::decode(const uint8_t* input, size_t len,
+							 LineInput& out) {
+	out = LineInput { input, 0, false, LineEvent::BREAK };
+	size_t consumed { 0 };
+
+	while (consumed < len) {
+		const uint8_t b { input[consumed] };
+
+		switch (current_state) {
+		case ParmrkState::DATA:
+			if (b == 0xff) {
+				// Return the run decoded so far, before the escape sequence
+				if (out.len)
+					return consumed;
+				current_state = ParmrkState::ESCAPE;
+			} else {
+				if (!out.len)
+					out.data = (input + consumed);
+				out.len += 1;
+			}
+			consumed += 1;
+			break;
+		case ParmrkState::ESCAPE:
+			consumed += 1;
+			if (b == 0x00) {
+				current_state = ParmrkState::ESCAPE_NUL;
+				break;
+			}
+			// \377 \377 is an escaped data byte. Any other byte does not
+			// follow an escape, and is passed through as data.
+			current_state = ParmrkState::DATA;
+			out.data = (input + consumed - 1);
+			out.len = 1;
+			return consumed;
+		case ParmrkState::ESCAPE_NUL:
+			consumed += 1;
+			current_state = ParmrkState::DATA;
+			out.event_valid = true;
+			out.event = (b == 0x00) ? LineEvent::BREAK : LineEvent::BYTE_ERROR;
+			return consumed;
+		}
+	}
+
+	return consumed;
+}
+
+void ParmrkDecoder::reset_state() {
+	current_state = ParmrkState::DATA;
+}
+}
@@ -0,0 +1,101 @@
+/**
+ * \file EV3UartParmrkDecoderSensorSide.hpp
+ *
+ * Header file for the decoder of termios \c PARMRK marked input, which
+ * separates line events from the data sent by the EV3
+ *
+ * \copyright Shenghao Yang, 2018
+ * 
+ * See LICENSE for details
+ */
+
+#ifndef EV3UARTPARMRKDECODERSENSORSIDE_HPP_
+#define EV3UARTPARMRKDECODERSENSORSIDE_HPP_
+
+#include <EV3UartProtocolParserSensorSide.hpp>
+
+namespace EV3UartProtocolParserSensorSide {
+
+/**
+ * Enumeration listing the states the \c PARMRK decoder can be in
+ */
+enum class ParmrkState : uint8_t {
+	DATA,			///< Decoder is passing data bytes through
+	ESCAPE,			///< Decoder received a \c \\377 byte
+	ESCAPE_NUL,		///< Decoder received a \c \\377 \c \\0 sequence
+};
+
+/**
+ * Structure returned by the ParmrkDecoder::decode() function.
+ */
+struct LineInput {
+	/**
+	 * Pointer to the data bytes decoded. Points into the block passed to
+	 * ParmrkDecoder::decode(), so the bytes are not copied.
+	 */
+	const uint8_t* data;
+	size_t len;				///< Number of data bytes decoded, may be \c 0
+	bool event_valid;		///< \c true if a line event was decoded
+	LineEvent event;		///< Line event decoded, if \c event_valid
+};
+
+/**
+ * Decoder for input read from a Linux tty with the \c PARMRK and \c INPCK
+ * input flags set, and \c IGNPAR, \c IGNBRK, \c BRKINT and \c ISTRIP
+ * cleared.
+ *
+ * In that mode, the tty driver marks line conditions in the data:
+ * Sequence          | Meaning
+ * ------------------|--------
+ * \c \\377 \c \\377 | Data byte \c \\377
+ * \c \\377 \c \\0 \c \\0 | Break condition
+ * \c \\377 \c \\0 \c X | Byte \c X received with framing or parity error
+ *
+ * The decoder splits a block of such input into runs of data bytes, which
+ * can be passed to the parser as-is, and line events for
+ * Parser::line_event(). Escape sequences may be split across blocks.
+ * \code{.cpp}
+ * while (len) {
+ *     LineInput in { };
+ *     size_t consumed { d.decode(block, len, in) };
+ *     block += consumed;
+ *     len -= consumed;
+ *     parse_block(p, in.data, in.len);
+ *     if (in.event_valid)
+ *         p.line_event(in.event);
+ * }
+ * \endcode
+ *
+ * \note A byte \c \\0 received with a framing or parity error cannot be
+ * told apart from a break condition, and is decoded as LineEvent::BREAK.
+ */
+class ParmrkDecoder {
+private:
+	ParmrkState current_state = ParmrkState::DATA;
+public:
+	ParmrkDecoder();
+
+	/**
+	 * Decode a block of input from the tty
+	 *
+	 * Bytes are consumed until a line event is decoded, a run of data bytes
+	 * is interrupted by an escape sequence, or the block is exhausted.
+	 * Data bytes decoded, if any, precede the line event decoded, if any.
+	 *
+	 * @param input pointer to the block of input
+	 * @param len length of the block, in bytes
+	 * @param out \ref LineInput structure that receives the data bytes and
+	 * line event decoded
+	 * @return number of bytes consumed from \c input
+	 */
+	size_t decode(const uint8_t* input, size_t len, LineInput& out);
+
+	/**
+	 * Reset the state of the decoder, discarding any partially received
+	 * escape sequence
+	 */
+	void reset_state();
+};
+}
+
+#endif /* EV3UARTPARMRKDECODERSENSORSIDE_HPP_ */
@@ -0,0 +1,198 @@
+/**
+ * \file EV3UartProtocolParserHostSide.cpp
+ *
+ * Definitions for the parser for EV3 UART sensor protocol messages sent
+ * from the sensor to the EV3
+ *
+ * \copyright Shenghao Yang, 2018
+ *
+ * See LICENSE for details
+ */
+
+#include <EV3UartProtocolParserHostSide.hpp>
+#include <stdint.h>
+
+namespace EV3UartProtocolParserSensorSide {
+
+using namespace EV3UartGenerator;
+
+namespace {
+
+/**
+ * Value returned by classify_host_header() for invalid header bytes
+ */
+constexpr uint8_t HEADER_INVALID { 0xff };
+
+/**
+ * Classify a header byte of a message sent from the sensor to the EV3
+ *
+ * @param hdr message header byte
+ * @return number of bytes between the header and FCS bytes of the message,
+ * \c 0 for SYS messages, or \ref HEADER_INVALID if the header byte is not
+ * valid
+ */
+constexpr uint8_t classify_host_header(const uint8_t hdr) {
+	const uint8_t payload_len_code { static_cast<uint8_t>((hdr >> 0x03) & 0x07) };
+
+	switch (hdr & 0xc0) {
+	case static_cast<uint8_t>(Magics::INFO::INFO_BASE):
+		// Info type byte, payload
+		return (payload_len_code < 6)
+			   ? (two_pow(payload_len_code) + 0x01) : HEADER_INVALID;
+	case static_cast<uint8_t>(Magics::DATA::DATA_BASE):
+		return (payload_len_code < 6)
+			   ? two_pow(payload_len_code) : HEADER_INVALID;
+	default:
+		break;
+	}
+
+	switch (hdr & 0xc7) {
+	case (static_cast<uint8_t>(Magics::SYS::SYS_BASE)
+		  | static_cast<uint8_t>(Magics::SYS::SYNC)):
+	case (static_cast<uint8_t>(Magics::SYS::SYS_BASE)
+		  | static_cast<uint8_t>(Magics::SYS::ACK)):
+		return (payload_len_code == 0) ? 0x00 : HEADER_INVALID;
+
+	case (static_cast<uint8_t>(Magics::CMD::CMD_BASE)
+		  | static_cast<uint8_t>(Magics::CMD::TYPE)):
+	case (static_cast<uint8_t>(Magics::CMD::CMD_BASE) | CMD_EXT_MODE):
+		return (payload_len_code == 0)
+			   ? two_pow(payload_len_code) : HEADER_INVALID;
+
+	case (static_cast<uint8_t>(Magics::CMD::CMD_BASE)
+		  | static_cast<uint8_t>(Magics::CMD::MODES)):
+		return (payload_len_code < 3)
+			   ? two_pow(payload_len_code) : HEADER_INVALID;
+
+	case (static_cast<uint8_t>(Magics::CMD::CMD_BASE)
+		  | static_cast<uint8_t>(Magics::CMD::SPEED)):
+		return (payload_len_code == 2)
+			   ? two_pow(payload_len_code) : HEADER_INVALID;
+
+	default:
+		return HEADER_INVALID;
+	}
+}
+}
+
+HostParseResult HostParser::message_result(const uint8_t hdr) {
+	switch (hdr & 0xc0) {
+	case static_cast<uint8_t>(Magics::INFO::INFO_BASE):
+		return HostParseResult::RECEIVED_INFO;
+	case static_cast<uint8_t>(Magics::DATA::DATA_BASE):
+		return HostParseResult::RECEIVED_DATA;
+	default:
+		break;
+	}
+
+	switch (hdr & 0x07) { // Mask out irrelevant bits
+	case static_cast<uint8_t>(Magics::CMD::TYPE):
+		return HostParseResult::RECEIVED_CMD_TYPE;
+	case static_cast<uint8_t>(Magics::CMD::MODES):
+		return HostParseResult::RECEIVED_CMD_MODES;
+	case static_cast<uint8_t>(Magics::CMD::SPEED):
+		return HostParseResult::RECEIVED_CMD_SPEED;
+	case CMD_EXT_MODE:
+		return HostParseResult::RECEIVED_CMD_EXT_MODE;
+	default:
+		// Command accepted by classify_host_header() without a result
+		return HostParseResult::RECEIVED_INVALID_HEADER;
+	}
+}
+
+HostParser::HostParser() {
+
+}
+
+HostParserReturn HostParser::update(uint8_t input) {
+	HostParserReturn rtn { };
+
+	switch (current_state) {
+	case State::WAIT_HEADER:
+		{
+			const uint8_t entry { classify_host_header(input) };
+			buffer[0] = input;
+			if (entry == HEADER_INVALID) {
+				rtn.res = HostParseResult::RECEIVED_INVALID_HEADER;
+			} else if (entry > 0) {	// Not SYS - setup byte counters
+				message_payload_length = entry;
+				message_pending_bytes = (entry + 0x01); // + 1 FCS
+				rtn.res = HostParseResult::INSUFFICIENT_DATA;
+				current_state = next_state(current_state);
+			} else {				// SYS - translate and return
+				rtn.res = ((input & 0x07)
+						   == static_cast<uint8_t>(Magics::SYS::ACK))
+						  ? HostParseResult::RECEIVED_SYS_ACK
+						  : HostParseResult::RECEIVED_SYS_SYNC;
+			}
+		}
+		break;
+	case State::WAIT_CHECKSUM:
+		const uint8_t index { write_index() };
+		buffer[index] = input;
+		message_pending_bytes -= 0x01;
+
+		if (message_pending_bytes) {
+			rtn.res = HostParseResult::INSUFFICIENT_DATA;
+		} else {
+			if (Framing::checksum(buffer, message_payload_length + 1) // + header
+				!= buffer[index]) {
+				rtn.res = HostParseResult::RECEIVED_INVALID_FCS;
+				rtn.len = message_payload_length;
+			} else {
+				rtn.res = message_result(buffer[0]);
+				rtn.len = (rtn.res == HostParseResult::RECEIVED_INFO)
+						  ? (message_payload_length - 0x01)
+						  : message_payload_length;
+			}
+			current_state = next_state(current_state);
+		}
+		break;
+	}
+
+	if (rtn.res != HostParseResult::INSUFFICIENT_DATA)
+		track_mode_offset(rtn.res == HostParseResult::RECEIVED_CMD_EXT_MODE,
+						  rtn.res == HostParseResult::RECEIVED_DATA);
+
+	rtn.hdr = buffer[0];
+	return rtn;
+}
+
+size_t HostParser::update(const uint8_t* input, size_t len,
+						  HostParserReturn& rtn) {
+	size_t consumed { 0 };
+	rtn = HostParserReturn { HostParseResult::INSUFFICIENT_DATA, buffer[0],
+							 0x00 };
+
+	while (consumed < len) {
+		const size_t run { copy_payload(input + consumed, len - consumed) };
+		if (run) {
+			consumed += run;
+			continue;
+		}
+
+		rtn = update(input[consumed++]);
+		if (rtn.res != HostParseResult::INSUFFICIENT_DATA)
+			break;
+	}
+
+	return consumed;
+}
+
+const uint8_t* HostParser::data() const {
+	return ((buffer[0] & 0xc0)
+			== static_cast<uint8_t>(Magics::INFO::INFO_BASE))
+		   ? (buffer + 2) : (buffer + 1);
+}
+
+uint8_t HostParser::info_type() const {
+	return buffer[1];
+}
+
+uint8_t HostParser::mode() const {
+	const uint8_t header_mode { static_cast<uint8_t>(buffer[0] & 0x07) };
+	if ((buffer[0] & 0xc0) == static_cast<uint8_t>(Magics::INFO::INFO_BASE))
+		return header_mode + ((buffer[1] & INFO_MODE_PLUS_8) ? 0x08 : 0x00);
+	return header_mode + current_mode_offset;
+}
+}
@@ -0,0 +1,204 @@
+/**
+ * \file EV3UartProtocolParserHostSide.hpp
+ *
+ * Header file for the parser for EV3 UART sensor protocol messages sent
+ * from the sensor to the EV3
+ *
+ * \copyright Shenghao Yang, 2018
+ *
+ * See LICENSE for details
+ */
+
+#ifndef EV3UARTPROTOCOLPARSERHOSTSIDE_HPP_
+#define EV3UARTPROTOCOLPARSERHOSTSIDE_HPP_
+
+#include <EV3UartProtocolParserSensorSide.hpp>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace EV3UartProtocolParserSensorSide {
+
+/**
+ * Bit set in the info type byte of an INFO message describing one of the
+ * modes 8 - 15
+ */
+constexpr uint8_t INFO_MODE_PLUS_8 { 0x20 };
+
+/**
+ * Enumeration listing the possible results from parsing an additional byte
+ * of data coming from the sensor, returned by HostParser
+ */
+enum class HostParseResult : uint8_t {
+	/**
+	 * The parser does not currently have sufficient data to return a
+	 * significant parsing result. More data should be passed to the
+	 * \ref HostParser::update() function.
+	 */
+	INSUFFICIENT_DATA,
+	/**
+	 * The parser received an invalid header byte, a byte that is not the
+	 * header for any message that a sensor can send to the EV3.
+	 *
+	 * The reasons for this could be:
+	 * - Invalid header byte sub-type (not [SYNC, ACK] for SYS types, or not
+	 *   [TYPE, MODES, SPEED, EXT_MODE] for CMD types)
+	 * - Invalid payload length in header byte (not [0] for SYS types, or
+	 *   not [1] for TYPE and EXT_MODE sub-types, or not [1, 4] for MODES
+	 *   sub-type, or not [4] for SPEED sub-type, or not [1, 32] for INFO
+	 *   and DATA types)
+	 */
+	RECEIVED_INVALID_HEADER,
+	/**
+	 * Parser received a SYS SYNC message
+	 */
+	RECEIVED_SYS_SYNC,
+	/**
+	 * Parser received a SYS ACK message
+	 */
+	RECEIVED_SYS_ACK,
+	/**
+	 * Parser received a CMD TYPE message with good FCS
+	 */
+	RECEIVED_CMD_TYPE,
+	/**
+	 * Parser received a CMD MODES message with good FCS
+	 */
+	RECEIVED_CMD_MODES,
+	/**
+	 * Parser received a CMD SPEED message with good FCS.
+	 * The baud rate is available from \ref HostParser::speed()
+	 */
+	RECEIVED_CMD_SPEED,
+	/**
+	 * Parser received a CMD EXT_MODE message with good FCS.
+	 * The offset it carries applies to the next DATA message, see
+	 * \ref HostParser::mode()
+	 */
+	RECEIVED_CMD_EXT_MODE,
+	/**
+	 * Parser received an INFO message with good FCS
+	 */
+	RECEIVED_INFO,
+	/**
+	 * Parser received a DATA message with good FCS
+	 */
+	RECEIVED_DATA,
+	/**
+	 * Parser received a CMD, INFO or DATA message with invalid FCS
+	 */
+	RECEIVED_INVALID_FCS,
+};
+
+/**
+ * Structure returned by the HostParser::update() function.
+ *
+ * HostParserReturn::hdr is always valid.
+ *
+ * The HostParserReturn::len values can be interpreted this way:
+ * res                       |len
+ * --------------------------|---
+ * INSUFFICIENT_DATA		 | No meaning
+ * RECEIVED_INVALID_HEADER	 | No meaning
+ * RECEIVED_SYS_SYNC		 | No meaning
+ * RECEIVED_SYS_ACK			 | No meaning
+ * RECEIVED_CMD_TYPE		 | Length of the TYPE message's payload (1 byte)
+ * RECEIVED_CMD_MODES		 | Length of the MODES message's payload
+ * RECEIVED_CMD_SPEED		 | Length of the SPEED message's payload (4 bytes)
+ * RECEIVED_CMD_EXT_MODE	 | Length of the EXT_MODE message's payload (1 byte)
+ * RECEIVED_INFO			 | Length of the INFO message's payload, excluding
+ * 							 | the info type byte
+ * RECEIVED_DATA			 | Length of the DATA message's payload
+ * RECEIVED_INVALID_FCS		 | Length of the bytes between the header and FCS
+ */
+struct HostParserReturn {
+	HostParseResult res; ///< Result of parsing
+	uint8_t hdr;		 ///< Header of the parsed message
+	uint8_t len;		 ///< Payload length of the parsed message
+};
+
+/**
+ * Parser for parsing EV3 UART sensor protocol messages that come from the
+ * sensor, e.g. for tapping the line from the sensor to the EV3.
+ *
+ * Messages are checked with the same FCS as Parser, and the results are
+ * reported in the same way. The message being parsed is held by
+ * MessageAssembler, shared with Parser, through which bytes_needed(),
+ * speed(), line_event() and reset_state() are provided. For INFO messages,
+ * \c buffer[1] holds the info type byte.
+ */
+class HostParser : public MessageAssembler {
+private:
+	/**
+	 * Translate the header byte of a CMD, INFO or DATA message with good
+	 * FCS into the corresponding parsing result
+	 *
+	 * @param hdr message header byte, must be a valid header
+	 * @return parsing result for the message, or
+	 * HostParseResult::RECEIVED_INVALID_HEADER for commands without a result
+	 */
+	static HostParseResult message_result(const uint8_t hdr);
+public:
+	HostParser();
+	HostParser(const HostParser&) = delete;
+
+	/**
+	 * Update the parser with one byte of information from the sensor
+	 *
+	 * @param input byte of information from the sensor
+	 * @return \ref HostParserReturn structure containing parsing information
+	 */
+	HostParserReturn update(uint8_t input);
+
+	/**
+	 * Update the parser with a block of information from the sensor, with
+	 * the same semantics as
+	 * Parser::update(const uint8_t*, size_t, ParserReturn&)
+	 *
+	 * @param input pointer to the block of information from the sensor
+	 * @param len length of the block, in bytes
+	 * @param rtn \ref HostParserReturn structure that receives the parsing
+	 * information for the last byte consumed
+	 * @return number of bytes consumed from \c input
+	 */
+	size_t update(const uint8_t* input, size_t len, HostParserReturn& rtn);
+
+	/**
+	 * Obtain a pointer to the payload of the message last parsed, with the
+	 * same constraints as Parser::data().
+	 *
+	 * For INFO messages, the payload starts after the info type byte, see
+	 * info_type().
+	 *
+	 * @return pointer to the payload of the message last parsed
+	 */
+	const uint8_t* data() const;
+
+	/**
+	 * Obtain the info type byte of the INFO message last parsed
+	 *
+	 * @pre update() returned a HostParserReturn structure that has
+	 * HostParserReturn::res set to HostParseResult::RECEIVED_INFO. If this
+	 * precondition is not met, the value returned is meaningless.
+	 *
+	 * @return info type byte, including \ref INFO_MODE_PLUS_8
+	 */
+	uint8_t info_type() const;
+
+	/**
+	 * Obtain the effective mode of the INFO or DATA message last parsed
+	 *
+	 * For INFO messages, \ref INFO_MODE_PLUS_8 in the info type byte adds
+	 * \c 8 to the mode in the header byte. For DATA messages, the offset
+	 * from a CMD EXT_MODE message received immediately before it is added.
+	 *
+	 * @pre update() returned a HostParserReturn structure that has
+	 * HostParserReturn::res set to HostParseResult::RECEIVED_INFO or
+	 * HostParseResult::RECEIVED_DATA.
+	 *
+	 * @return effective mode, in the range [0, 15]
+	 */
+	uint8_t mode() const;
+};
+}
+
+#endif /* EV3UARTPROTOCOLPARSERHOSTSIDE_HPP_ */
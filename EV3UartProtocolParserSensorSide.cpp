@@ -10,6 +10,7 @@
 
 #include <EV3UartProtocolParserSensorSide.hpp>
 #include <stdint.h>
+#include <string.h>
 
 namespace EV3UartProtocolParserSensorSide {
 
@@ -56,6 +57,21 @@ Parser::HeaderInformation Parser::analyze_header(const uint8_t hdr) {
 		}
 		break;
 
+	case (static_cast<uint8_t>(Magics::CMD::CMD_BASE) | CMD_EXT_MODE):
+		if (payload_len_code == 0) {
+			info.header_valid = true;
+			info.payload_length = payload_length(hdr);
+		}
+		break;
+
+	case (static_cast<uint8_t>(Magics::CMD::CMD_BASE)
+		  | static_cast<uint8_t>(Magics::CMD::SPEED)):
+		if (payload_len_code == 2) {
+			info.header_valid = true;
+			info.payload_length = payload_length(hdr);
+		}
+		break;
+
 	default:
 		break;
 	}
@@ -63,6 +79,76 @@ Parser::HeaderInformation Parser::analyze_header(const uint8_t hdr) {
 	return info;
 }
 
+uint8_t MessageAssembler::write_index() const {
+	return ((message_payload_length + 0x01) - message_pending_bytes) + 0x01;
+}
+
+size_t MessageAssembler::copy_payload(const uint8_t* input, size_t len) {
+	if ((current_state != State::WAIT_CHECKSUM)
+		|| (message_pending_bytes <= 0x01))
+		return 0;
+
+	// Copy bytes that cannot complete the message directly, leaving the
+	// FCS byte to be parsed on its own
+	size_t run { static_cast<size_t>(message_pending_bytes - 0x01) };
+	if (run > len)
+		run = len;
+	memcpy(buffer + write_index(), input, run);
+	message_pending_bytes -= run;
+	return run;
+}
+
+void MessageAssembler::track_mode_offset(bool ext_mode, bool applies) {
+	// EXT_MODE offsets only apply to the message directly following them
+	if (ext_mode) {
+		pending_mode_offset = (buffer[1] & 0x08);
+		return;
+	}
+	if (applies)
+		current_mode_offset = pending_mode_offset;
+	pending_mode_offset = 0;
+}
+
+uint8_t MessageAssembler::bytes_needed() const {
+	return (current_state == State::WAIT_CHECKSUM)
+		   ? message_pending_bytes : static_cast<uint8_t>(0x01);
+}
+
+uint32_t MessageAssembler::speed() const {
+	return (static_cast<uint32_t>(buffer[1])
+			| (static_cast<uint32_t>(buffer[2]) << 8)
+			| (static_cast<uint32_t>(buffer[3]) << 16)
+			| (static_cast<uint32_t>(buffer[4]) << 24));
+}
+
+bool MessageAssembler::line_event(LineEvent ev) {
+	static_cast<void>(ev); // Every event corrupts the message being parsed
+	const bool abandoned { current_state != State::WAIT_HEADER };
+	reset_state();
+	return abandoned;
+}
+
+void MessageAssembler::reset_state() {
+	current_state = State::STATE_START;
+	pending_mode_offset = 0;
+}
+
+ParseResult Parser::command_result(const uint8_t hdr) {
+	switch (hdr & 0x07) { // Mask out irrelevant bits
+	case static_cast<uint8_t>(Magics::CMD::SELECT):
+		return ParseResult::RECEIVED_CMD_SELECT;
+	case static_cast<uint8_t>(Magics::CMD::WRITE):
+		return ParseResult::RECEIVED_CMD_WRITE;
+	case static_cast<uint8_t>(Magics::CMD::SPEED):
+		return ParseResult::RECEIVED_CMD_SPEED;
+	case CMD_EXT_MODE:
+		return ParseResult::RECEIVED_CMD_EXT_MODE;
+	default:
+		// Command accepted by analyze_header() without a result of its own
+		return ParseResult::RECEIVED_INVALID_HEADER;
+	}
+}
+
 Parser::Parser() {
 
 }
@@ -100,9 +186,8 @@ ParserReturn Parser::update(uint8_t input) {
 		}
 		break;
 	case State::WAIT_CHECKSUM:
-		const uint8_t write_index { ((message_payload_length + 0x01)
-								    - message_pending_bytes) + 0x01 };
-		buffer[write_index] = input;
+		const uint8_t index { write_index() };
+		buffer[index] = input;
 		message_pending_bytes -= 0x01;
 
 		if (message_pending_bytes) {
@@ -110,27 +195,121 @@ ParserReturn Parser::update(uint8_t input) {
 		} else {
 			rtn.len = message_payload_length; // len must be valid for RECEIVED_CMD_*
 			if (Framing::checksum(buffer, message_payload_length + 1) // + 1 for header
-			 	!= buffer[write_index]) {     // Checksum Error
+			 	!= buffer[index]) {           // Checksum Error
 				rtn.res = ParseResult::RECEIVED_CMD_INVALID_FCS;
 			} else {					      // Checksum OK
-				switch (buffer[0] & 0x07) {   // Mask out irrelevant bits
-				case static_cast<uint8_t>(Magics::CMD::SELECT):
-					rtn.res = ParseResult::RECEIVED_CMD_SELECT;
-					break;
-				case static_cast<uint8_t>(Magics::CMD::WRITE):
-					rtn.res = ParseResult::RECEIVED_CMD_WRITE;
-					break;
-				}
+				rtn.res = command_result(buffer[0]);
 			}
 			current_state = next_state(current_state); // Increment state
 		}
 		break;
 	}
 
+	if (rtn.res != ParseResult::INSUFFICIENT_DATA)
+		track_mode_offset(rtn.res == ParseResult::RECEIVED_CMD_EXT_MODE,
+						  (rtn.res == ParseResult::RECEIVED_CMD_SELECT)
+						  || (rtn.res == ParseResult::RECEIVED_CMD_WRITE));
+
 	rtn.hdr = buffer[0];
 	return rtn;
 }
 
+size_t Parser::update(const uint8_t* input, size_t len, ParserReturn& rtn) {
+	size_t consumed { 0 };
+	rtn = ParserReturn { ParseResult::INSUFFICIENT_DATA, buffer[0], 0x00 };
+
+	while (consumed < len) {
+		const size_t run { copy_payload(input + consumed, len - consumed) };
+		if (run) {
+			consumed += run;
+			continue;
+		}
+
+		rtn = update(input[consumed++]);
+		if (rtn.res != ParseResult::INSUFFICIENT_DATA)
+			break;
+	}
+
+	return consumed;
+}
+
+namespace {
+
+/**
+ * Length of CMD SELECT and CMD EXT_MODE frames: header, payload byte, FCS
+ */
+constexpr uint8_t SHORT_FRAME_LEN { 0x03 };
+
+/**
+ * Check whether a block starts with a complete frame with a single byte
+ * payload and good FCS
+ *
+ * @param input pointer to the block
+ * @param len length of the block, in bytes
+ * @param hdr header byte the frame must start with
+ * @return \c true if the frame is present and will parse successfully
+ */
+bool short_frame_at(const uint8_t* input, size_t len, const uint8_t hdr) {
+	return (len >= SHORT_FRAME_LEN) && (input[0] == hdr)
+		   && (Framing::checksum(input, 0x02) == input[0x02]);
+}
+}
+
+size_t Parser::update_coalesced(const uint8_t* input, size_t len,
+								ParserReturn& rtn, CoalesceStatistics& stats) {
+	size_t consumed { update(input, len, rtn) };
+
+	switch (rtn.res) {
+	case ParseResult::RECEIVED_CMD_SELECT:
+		{
+			constexpr uint8_t select_header {
+				static_cast<uint8_t>(Magics::CMD::CMD_BASE)
+				| static_cast<uint8_t>(Magics::CMD::SELECT)
+			};
+			constexpr uint8_t ext_mode_header {
+				static_cast<uint8_t>(Magics::CMD::CMD_BASE) | CMD_EXT_MODE
+			};
+			// Only skip ahead to complete SELECT frames, optionally preceded
+			// by the EXT_MODE frame carrying their offset, that will parse
+			// successfully, so that the last good one is always reported
+			while (consumed < len) {
+				const uint8_t* next { input + consumed };
+				const size_t left { len - consumed };
+				if (short_frame_at(next, left, select_header)) {
+					consumed += update(next, SHORT_FRAME_LEN, rtn);
+				} else if (short_frame_at(next, left, ext_mode_header)
+						   && short_frame_at(next + SHORT_FRAME_LEN,
+											 left - SHORT_FRAME_LEN,
+											 select_header)) {
+					consumed += update(next, SHORT_FRAME_LEN, rtn);
+					consumed += update(next + SHORT_FRAME_LEN,
+									   SHORT_FRAME_LEN, rtn);
+				} else {
+					break;
+				}
+				stats.select_collapsed += 1;
+			}
+		}
+		break;
+	case ParseResult::RECEIVED_SYS_ACK:
+		{
+			constexpr uint8_t ack_header {
+				static_cast<uint8_t>(Magics::SYS::SYS_BASE)
+				| static_cast<uint8_t>(Magics::SYS::ACK)
+			};
+			while ((consumed < len) && (input[consumed] == ack_header)) {
+				rtn = update(input[consumed++]);
+				stats.ack_collapsed += 1;
+			}
+		}
+		break;
+	default:
+		break;
+	}
+
+	return consumed;
+}
+
 uint8_t* Parser::data() {
 	return (buffer + 1);
 }
@@ -139,8 +318,261 @@ const uint8_t* Parser::data() const {
 	return (buffer + 1);
 }
 
-void Parser::reset_state() {
-	current_state = State::STATE_START;
+uint8_t Parser::mode_offset() const {
+	return current_mode_offset;
+}
+
+uint8_t Parser::selected_mode() const {
+	return (buffer[1] + current_mode_offset);
+}
+
+uint8_t Parser::snapshot(uint8_t* out) const {
+	const uint8_t received { (current_state == State::WAIT_CHECKSUM)
+							 ? write_index() : static_cast<uint8_t>(0x00) };
+
+	out[0] = SNAPSHOT_VERSION;
+	out[1] = static_cast<uint8_t>(current_state);
+	out[2] = message_payload_length;
+	out[3] = message_pending_bytes;
+	out[4] = (pending_mode_offset | (current_mode_offset << 0x04));
+	memcpy(out + SNAPSHOT_HEADER_LEN, buffer, received);
+	return (SNAPSHOT_HEADER_LEN + received);
+}
+
+size_t Parser::restore(const uint8_t* in, size_t len) {
+	if ((len < SNAPSHOT_HEADER_LEN) || (in[0] != SNAPSHOT_VERSION))
+		return 0;
+
+	const uint8_t pending_offset { static_cast<uint8_t>(in[4] & 0x0f) };
+	const uint8_t current_offset { static_cast<uint8_t>(in[4] >> 0x04) };
+	if (((pending_offset != 0x00) && (pending_offset != 0x08))
+		|| ((current_offset != 0x00) && (current_offset != 0x08)))
+		return 0;
+
+	uint8_t received { 0 };
+	switch (in[1]) {
+	case static_cast<uint8_t>(State::WAIT_HEADER):
+		break;
+	case static_cast<uint8_t>(State::WAIT_CHECKSUM):
+		{
+			// Pending bytes include the FCS, so at least one is pending
+			if ((!in[3]) || (in[3] > (in[2] + 0x01)))
+				return 0;
+			received = ((in[2] + 0x01) - in[3]) + 0x01;
+			if (len < static_cast<size_t>(SNAPSHOT_HEADER_LEN + received))
+				return 0;
+
+			// Only CMD messages span more than the header byte
+			const HeaderInformation info {
+				analyze_header(in[SNAPSHOT_HEADER_LEN])
+			};
+			if ((!info.header_valid) || (!info.payload_length)
+				|| ((info.header_sanitized & 0xc0)
+					!= static_cast<uint8_t>(Magics::CMD::CMD_BASE))
+				|| (info.payload_length != in[2]))
+				return 0;
+		}
+		break;
+	default:
+		return 0;
+	}
+
+	current_state = static_cast<State>(in[1]);
+	message_payload_length = in[2];
+	message_pending_bytes = in[3];
+	pending_mode_offset = pending_offset;
+	current_mode_offset = current_offset;
+	memcpy(buffer, in + SNAPSHOT_HEADER_LEN, received);
+	return (SNAPSHOT_HEADER_LEN + received);
+}
+
+size_t snapshot(const Parser* parsers, size_t count, uint8_t* out) {
+	size_t written { 0 };
+	for (size_t i = 0; i < count; i++)
+		written += parsers[i].snapshot(out + written);
+	return written;
+}
+
+size_t restore(Parser* parsers, size_t count, const uint8_t* in, size_t len) {
+	size_t read { 0 };
+	for (size_t i = 0; i < count; i++) {
+		const size_t consumed { parsers[i].restore(in + read, len - read) };
+		if (!consumed)
+			return 0;
+		read += consumed;
+	}
+	return read;
+}
+
+static_assert(RESYNC_WINDOW_LEN >= (0x20 + 0x02),
+			  "ResyncParser window must hold the longest message");
+static_assert(RESYNC_WINDOW_LEN <= 64,
+			  "ResyncParser hypotheses must fit in 64 bits");
+
+namespace {
+
+/**
+ * Obtain the index of the lowest bit set in a set of hypotheses
+ *
+ * @param set set of hypotheses, must not be empty
+ * @return index of the lowest bit set
+ */
+uint8_t oldest(const uint64_t set) {
+	uint8_t first { 0 };
+	while (!(set & (static_cast<uint64_t>(0x01) << first)))
+		first++;
+	return first;
+}
+
+/**
+ * Obtain the set of hypotheses starting before an index
+ *
+ * @param index index into the window, may be past its end
+ * @return mask with bits [0, index) set
+ */
+uint64_t older_than(const uint8_t index) {
+	return (index >= 64) ? ~static_cast<uint64_t>(0x00)
+						 : ((static_cast<uint64_t>(0x01) << index) - 0x01);
+}
+}
+
+ResyncParser::ResyncParser() {
+
+}
+
+void ResyncParser::compact() {
+	if ((window_length == RESYNC_WINDOW_LEN) && (hypotheses | completed)) {
+		// Messages held back behind others for too long, make room
+		const uint64_t bit {
+			static_cast<uint64_t>(0x01) << oldest(hypotheses | completed)
+		};
+		hypotheses &= ~bit;
+		completed &= ~bit;
+	}
+
+	if (!(hypotheses | completed)) {
+		window_length = 0;
+		return;
+	}
+
+	const uint8_t first { oldest(hypotheses | completed) };
+	if (first) {
+		memmove(window, window + first, window_length - first);
+		window_length -= first;
+		hypotheses >>= first;
+		completed >>= first;
+	}
+}
+
+ParserReturn ResyncParser::update(uint8_t input) {
+	compact();
+
+	const uint8_t index { window_length++ };
+	window[index] = input;
+	ParserReturn rtn { ParseResult::INSUFFICIENT_DATA, input, 0x00 };
+	const bool pending { (hypotheses | completed) != 0 };
+
+	// Check hypotheses ending at this byte, oldest first
+	for (uint8_t start = 0; start < index; start++) {
+		const uint64_t bit { static_cast<uint64_t>(0x01) << start };
+		if (!(hypotheses & bit))
+			continue;
+
+		const uint8_t len {
+			Parser::analyze_header(window[start]).payload_length
+		};
+		if ((index - start) != (len + 0x01)) // header + payload + FCS
+			continue;
+
+		hypotheses &= ~bit;
+		if (Framing::checksum(window + start, len + 0x01) == input) {
+			completed |= bit;
+		} else if (!((hypotheses | completed) & older_than(start))) {
+			// Oldest hypothesis, the one Parser would follow
+			message_offset = start;
+			rtn.res = ParseResult::RECEIVED_CMD_INVALID_FCS;
+			rtn.hdr = window[start];
+			rtn.len = len;
+		}
+	}
+
+	const Parser::HeaderInformation info { Parser::analyze_header(input) };
+	const bool cmd_header { info.header_valid && (info.payload_length > 0) };
+	if (cmd_header) {
+		// CMD header - start a new hypothesis
+		hypotheses |= (static_cast<uint64_t>(0x01) << index);
+	}
+
+	// Report the oldest message held back, once no hypothesis covering it
+	// is pending
+	if (release(rtn))
+		return rtn;
+
+	if ((!pending) && (!cmd_header)
+		&& (rtn.res == ParseResult::INSUFFICIENT_DATA)) {
+		message_offset = index;
+		if (!info.header_valid) {
+			rtn.res = ParseResult::RECEIVED_INVALID_HEADER;
+		} else if ((info.header_sanitized & 0x07)
+				   == static_cast<uint8_t>(Magics::SYS::ACK)) {
+			rtn.res = ParseResult::RECEIVED_SYS_ACK;
+		} else {
+			rtn.res = ParseResult::RECEIVED_SYS_NACK;
+		}
+	}
+
+	return rtn;
+}
+
+bool ResyncParser::release(ParserReturn& rtn) {
+	if (!completed)
+		return false;
+
+	const uint8_t start { oldest(completed) };
+	if (hypotheses & older_than(start))
+		return false;
+
+	const uint8_t len { Parser::analyze_header(window[start]).payload_length };
+	// Discard every hypothesis overlapping the message
+	const uint64_t covered {
+		older_than(start + len + 0x02) & ~older_than(start + 0x01)
+	};
+	hypotheses &= ~covered;
+	completed &= ~(covered | (static_cast<uint64_t>(0x01) << start));
+
+	message_offset = start;
+	rtn.res = Parser::command_result(window[start]);
+	rtn.hdr = window[start];
+	rtn.len = len;
+	return true;
+}
+
+uint8_t* ResyncParser::data() {
+	return (window + message_offset + 1);
+}
+
+const uint8_t* ResyncParser::data() const {
+	return (window + message_offset + 1);
+}
+
+bool ResyncParser::line_event(LineEvent ev) {
+	static_cast<void>(ev); // Every event ends the messages being parsed
+	const bool abandoned { hypotheses != 0 };
+	hypotheses = 0;
+	return abandoned;
+}
+
+ParserReturn ResyncParser::flush() {
+	ParserReturn rtn { ParseResult::INSUFFICIENT_DATA, 0x00, 0x00 };
+	hypotheses = 0;
+	release(rtn);
+	return rtn;
+}
+
+void ResyncParser::reset_state() {
+	hypotheses = 0;
+	completed = 0;
+	window_length = 0;
 }
 }
 
@@ -43,12 +43,41 @@
  * ParserReturn r = p.update(data);
  * \endcode
  *
+ * When the UART backend delivers data in blocks (e.g. a DMA buffer or the
+ * result of a \c read() call), the block can be handed to the parser
+ * directly, without copying it byte-by-byte. The parser consumes bytes from
+ * the block until a result other than ParseResult::INSUFFICIENT_DATA is
+ * available, or until the block is exhausted:
+ * \code{.cpp}
+ * Parser p { };
+ * ParserReturn r { };
+ * while (len) {
+ *     size_t consumed { p.update(block, len, r) };
+ *     block += consumed;
+ *     len -= consumed;
+ *     if (r.res != ParseResult::INSUFFICIENT_DATA)
+ *         handle_result(r);
+ * }
+ * \endcode
+ *
+ * EV3UartProtocolParserSensorSide::Parser::bytes_needed() gives the number
+ * of bytes that must be read before the parser can produce a result, so
+ * that a reader can wait for a whole message per wakeup, e.g. by setting
+ * \c VMIN on a POSIX terminal before each blocking \c read(), with
+ * \c VTIME as the inter-byte timeout:
+ * \code{.cpp}
+ * tio.c_cc[VMIN] = p.bytes_needed();
+ * tio.c_cc[VTIME] = 1;
+ * tcsetattr(fd, TCSANOW, &tio);
+ * ssize_t len = read(fd, block, p.bytes_needed());
+ * \endcode
+ *
  * The various fields in the
  * EV3UartProtocolParserSensorSide::ParserReturn structure offers more information
  * on what was parsed. EV3UartProtocolParserSensorSide::Parser::data()
  * obtains the payload of the message sent
  * from the EV3, if the header byte from the EV3 does not represent the
- * entirety of the message (i.e. CMD_WRITE and CMD_SELECT messages)
+ * entirety of the message (i.e. CMD_WRITE, CMD_SELECT and CMD_SPEED messages)
  * \code{.cpp}
  * Parser p { };
  * uint8_t* data = p.data();
@@ -63,6 +92,26 @@
  * p.reset_state();
  * \endcode
  *
+ * On noisy connections, EV3UartProtocolParserSensorSide::ResyncParser can
+ * be used in place of the parser. It accepts the same input and reports the
+ * same results, but never loses a message with good FCS to a noise byte
+ * that looks like a header byte.
+ *
+ * The sensor side of the connection handshake, from sending the
+ * pre-framed handshake burst to switching to the data mode baud rate, can be
+ * sequenced by EV3UartProtocolParserSensorSide::Link, declared in
+ * \c EV3UartLinkSensorSide.hpp. Readings to be sent in reply to the EV3's
+ * SYS NACK messages can be kept pre-framed in a
+ * EV3UartProtocolParserSensorSide::DataCache, declared in
+ * \c EV3UartDataCacheSensorSide.hpp.
+ *
+ * Messages sent in the other direction, from the sensor to the EV3, can be
+ * parsed by EV3UartProtocolParserSensorSide::HostParser, declared in
+ * \c EV3UartProtocolParserHostSide.hpp. Both directions of a tapped
+ * connection can be decoded and correlated by
+ * EV3UartProtocolParserSensorSide::Sniffer, declared in
+ * \c EV3UartSniffer.hpp.
+ *
  * For more information, see EV3UartProtocolParserSensorSide
  *
  * Tests
@@ -88,6 +137,8 @@
 
 #include <magics.hpp>
 #include <framing.hpp>
+#include <stddef.h>
+#include <stdint.h>
 
 namespace EV3UartProtocolParserSensorSide {
 
@@ -97,6 +148,35 @@ namespace EV3UartProtocolParserSensorSide {
  */
 constexpr uint8_t BUFFER_LEN { EV3UartGenerator::Framing::BUFFER_MIN };
 
+/**
+ * Sub-type of the CMD EXT_MODE message, which is not listed in
+ * EV3UartGenerator::Magics::CMD.
+ *
+ * A CMD EXT_MODE message carries a 1 byte payload, the offset (\c 0 or
+ * \c 8) added to the mode addressed by the CMD SELECT or CMD WRITE message
+ * immediately following it, so that modes 8 - 15 can be reached.
+ */
+constexpr uint8_t CMD_EXT_MODE { 0x06 };
+
+/**
+ * Version of the format written by Parser::snapshot(). Snapshots of other
+ * versions are rejected by Parser::restore().
+ */
+constexpr uint8_t SNAPSHOT_VERSION { 1 };
+
+/**
+ * Length of the fixed part of a snapshot written by Parser::snapshot():
+ * version, state, payload length, pending byte count and mode offsets
+ */
+constexpr uint8_t SNAPSHOT_HEADER_LEN { 5 };
+
+/**
+ * Maximum length of a snapshot written by Parser::snapshot(): the fixed
+ * part, followed by the header and payload bytes of a partially parsed
+ * message
+ */
+constexpr uint8_t SNAPSHOT_MAX_LEN { SNAPSHOT_HEADER_LEN + 0x01 + 0x20 };
+
 /**
  * Raises two to the power of \c val
  *
@@ -152,10 +232,11 @@ enum class ParseResult : uint8_t {
 	 *
 	 * The reasons for this could be:
 	 * - Invalid header byte type (not CMD or SYS)
-	 * - Invalid header byte sub-type (not [SELECT, WRITE] for CMD types or
-	 *   not [ACK, NACK] for SYS types)
+	 * - Invalid header byte sub-type (not [SELECT, WRITE, SPEED, EXT_MODE]
+	 *   for CMD types or not [ACK, NACK] for SYS types)
 	 * - Invalid payload length in header byte (not [0] for SYS types, or
-	 *   not [1] for SELECT sub-type, or not [1, 32] for WRITE sub-type)
+	 *   not [1] for SELECT and EXT_MODE sub-types, or not [1, 32] for WRITE
+	 *   sub-type, or not [4] for SPEED sub-type)
 	 */
 	RECEIVED_INVALID_HEADER,
 	/**
@@ -174,6 +255,17 @@ enum class ParseResult : uint8_t {
 	 * Parser received a CMD WRITE message with good FCS
 	 */
 	RECEIVED_CMD_WRITE,
+	/**
+	 * Parser received a CMD SPEED message with good FCS.
+	 * The requested baud rate is available from \ref Parser::speed()
+	 */
+	RECEIVED_CMD_SPEED,
+	/**
+	 * Parser received a CMD EXT_MODE message with good FCS.
+	 * The offset it carries applies to the next CMD SELECT or CMD WRITE
+	 * message, see \ref Parser::mode_offset()
+	 */
+	RECEIVED_CMD_EXT_MODE,
 	/**
 	 * Parser received a CMD message with invalid FCS
 	 */
@@ -192,6 +284,8 @@ enum class ParseResult : uint8_t {
  * RECEIVED_SYS_NACK		 | Valid
  * RECEIVED_CMD_SELECT		 | Valid
  * RECEIVED_CMD_WRITE		 | Valid
+ * RECEIVED_CMD_SPEED		 | Valid
+ * RECEIVED_CMD_EXT_MODE	 | Valid
  * RECEIVED_CMD_INVALID_FCS	 | Valid
  *
  * The ParserReturn::len values can be interpreted this way:
@@ -203,6 +297,8 @@ enum class ParseResult : uint8_t {
  * RECEIVED_SYS_NACK		 | No meaning
  * RECEIVED_CMD_SELECT		 | Length of the SELECT message's payload (1 byte)
  * RECEIVED_CMD_WRITE		 | Length of the WRITE message's payload
+ * RECEIVED_CMD_SPEED		 | Length of the SPEED message's payload (4 bytes)
+ * RECEIVED_CMD_EXT_MODE	 | Length of the EXT_MODE message's payload (1 byte)
  * RECEIVED_CMD_INVALID_FCS	 | Length of the payload with invalid FCS
  */
 struct ParserReturn {
@@ -212,29 +308,173 @@ struct ParserReturn {
 };
 
 /**
- * Parser for parsing EV3 UART sensor protocol messages that come from the
- * EV3
+ * Enumeration listing the out-of-band events a UART backend can report
+ * about the line from the EV3, passed to Parser::line_event()
  */
-class Parser {
-private:
+enum class LineEvent : uint8_t {
+	/**
+	 * A break condition was detected on the line
+	 */
+	BREAK,
+	/**
+	 * A byte was received with a framing or parity error. The byte itself
+	 * should not be passed to the parser.
+	 */
+	BYTE_ERROR,
+	/**
+	 * No byte was received within the inter-byte timeout of the
+	 * application, e.g. one armed on a TimerWheel
+	 */
+	TIMEOUT,
+};
+
+/**
+ * Structure containing the number of messages collapsed by
+ * Parser::update_coalesced()
+ */
+struct CoalesceStatistics {
+	/**
+	 * Number of CMD SELECT messages that were superseded by a CMD SELECT
+	 * message immediately following them, possibly preceded by a
+	 * CMD EXT_MODE message, and were not reported
+	 */
+	uint32_t select_collapsed;
 	/**
-	 * Internal buffer used to buffer information from the EV3.
+	 * Number of SYS ACK messages that duplicated a SYS ACK message
+	 * immediately preceding them, and were not reported
+	 */
+	uint32_t ack_collapsed;
+};
+
+/**
+ * Message buffering and bookkeeping shared by the parsers for both
+ * directions of the line, Parser and HostParser.
+ *
+ * Holds the message being parsed, tracks the bytes left in it, and tracks
+ * the mode offsets carried by CMD EXT_MODE messages. Header bytes are
+ * classified, and results reported, by the parsers themselves.
+ */
+class MessageAssembler {
+protected:
+	/**
+	 * Internal buffer used to buffer the message being parsed.
 	 *
-	 * \c buffer[0] stores the header byte received from the EV3
-	 * \c buffer[1] stores the first byte of the payload from the EV3
-	 * \c buffer[payload_length + 1] stores the FCS byte received from the EV3
+	 * \c buffer[0] stores the header byte of the message
+	 * \c buffer[1] stores the first byte after the header byte
+	 * \c buffer[message_payload_length + 1] stores the FCS byte
 	 */
 	uint8_t buffer[BUFFER_LEN];
+	/**
+	 * Number of bytes between the header and FCS bytes of the message being
+	 * parsed
+	 */
 	uint8_t message_payload_length = 0;
 	uint8_t message_pending_bytes = 0;
 	State current_state = State::STATE_START;
+	/**
+	 * Mode offset from the last CMD EXT_MODE message, waiting to be applied
+	 * to the next message it applies to
+	 */
+	uint8_t pending_mode_offset = 0;
+	/**
+	 * Mode offset applied to the last message it applies to
+	 */
+	uint8_t current_mode_offset = 0;
+
+	/**
+	 * Obtain the index in \ref buffer the next byte received in the
+	 * State::WAIT_CHECKSUM state will be written to
+	 *
+	 * @return index into \ref buffer
+	 */
+	uint8_t write_index() const;
+
+	/**
+	 * Copy bytes that cannot complete the message being parsed into
+	 * \ref buffer directly, leaving the FCS byte to be parsed on its own
+	 *
+	 * @param input pointer to the bytes received
+	 * @param len number of bytes received
+	 * @return number of bytes copied from \c input, \c 0 if the next byte
+	 * has to be parsed on its own
+	 */
+	size_t copy_payload(const uint8_t* input, size_t len);
+
+	/**
+	 * Track the mode offset of CMD EXT_MODE messages, which only applies
+	 * to the message directly following them
+	 *
+	 * @param ext_mode \c true if the message parsed is a CMD EXT_MODE
+	 * message with good FCS, whose offset is in \c buffer[1]
+	 * @param applies \c true if the message parsed is one the offset
+	 * applies to
+	 */
+	void track_mode_offset(bool ext_mode, bool applies);
+public:
+	/**
+	 * Obtain the minimum number of bytes the parser needs before it can
+	 * produce a result other than ParseResult::INSUFFICIENT_DATA.
+	 *
+	 * While a message is being received, this is the number of bytes left
+	 * in it, including the FCS byte. Otherwise, the next byte is a header
+	 * byte, which may be a complete message by itself.
+	 *
+	 * @return number of bytes needed, in the range [1, 34]
+	 */
+	uint8_t bytes_needed() const;
+
+	/**
+	 * Obtain the baud rate carried by a CMD SPEED message.
+	 *
+	 * The baud rate is decoded from the little-endian payload of the
+	 * message.
+	 *
+	 * @pre The message last parsed is a CMD SPEED message with good FCS.
+	 * If this precondition is not met, the value returned is meaningless.
+	 *
+	 * @return baud rate, in bits per second
+	 */
+	uint32_t speed() const;
+
+	/**
+	 * Inform the parser of an out-of-band event on the line.
+	 *
+	 * Any partially parsed message is known to be corrupt, and is abandoned
+	 * immediately instead of waiting for its FCS check to fail. The next
+	 * byte input into the parser will be treated as a
+	 * <b> header byte </b> candidate.
+	 *
+	 * @param ev event that occurred on the line
+	 * @retval true a partially parsed message was abandoned
+	 * @retval false the parser was waiting for a header byte
+	 */
+	bool line_event(LineEvent ev);
+
+	/**
+	 * Reset the state of the parser, so that the next byte input into the
+	 * parser will be treated as a <b> header byte </b> candidate.
+	 *
+	 * Any mode offset from a CMD EXT_MODE message is discarded.
+	 */
+	void reset_state();
+};
+
+/**
+ * Parser for parsing EV3 UART sensor protocol messages that come from the
+ * EV3
+ *
+ * The message being parsed is held by MessageAssembler, through which
+ * bytes_needed(), speed(), line_event() and reset_state() are provided.
+ */
+class Parser : public MessageAssembler {
+private:
 
 	/**
 	 * Obtain the payload length from a valid message header byte
 	 * @param hdr message header byte
 	 * @return payload length of a particular message, in bytes.
 	 */
-	uint8_t payload_length(const uint8_t hdr);
+	static uint8_t payload_length(const uint8_t hdr);
 
 	/**
 	 * Structure containing header information from \ref analyze_header()
@@ -265,7 +505,19 @@ private:
 	 * @return \ref HeaderInformation structure containing information
 	 * about the header
 	 */
-	HeaderInformation analyze_header(const uint8_t hdr);
+	static HeaderInformation analyze_header(const uint8_t hdr);
+
+	/**
+	 * Translate the header byte of a CMD message with good FCS into the
+	 * corresponding parsing result
+	 *
+	 * @param hdr message header byte, must be a valid CMD header
+	 * @return parsing result for the message, or
+	 * ParseResult::RECEIVED_INVALID_HEADER for commands without a result
+	 */
+	static ParseResult command_result(const uint8_t hdr);
+
+	friend class ResyncParser;
 public:
 
 	// We use the default constructor, because we don't really need to do
@@ -282,6 +534,58 @@ public:
 	 */
 	ParserReturn update(uint8_t input);
 
+	/**
+	 * Update the parser with a block of information from the EV3
+	 *
+	 * Bytes are consumed from \c input until the parser produces a result
+	 * other than ParseResult::INSUFFICIENT_DATA, or until \c len bytes have
+	 * been consumed. Payload bytes that cannot complete a message are copied
+	 * into the parser in one go instead of being parsed one at a time.
+	 *
+	 * The results obtained are identical to passing the consumed bytes to
+	 * update(uint8_t), one after another, and keeping the last result.
+	 *
+	 * @param input pointer to the block of information from the EV3
+	 * @param len length of the block, in bytes
+	 * @param rtn \ref ParserReturn structure that receives the parsing
+	 * information for the last byte consumed. Set to
+	 * ParseResult::INSUFFICIENT_DATA if \c len is \c 0.
+	 * @return number of bytes consumed from \c input. Bytes that were not
+	 * consumed should be passed to the parser on the next call.
+	 */
+	size_t update(const uint8_t* input, size_t len, ParserReturn& rtn);
+
+	/**
+	 * Update the parser with a block of information from the EV3,
+	 * collapsing superseded messages within the block
+	 *
+	 * Behaves like update(const uint8_t*, size_t, ParserReturn&), except
+	 * that:
+	 * - A CMD SELECT message that is immediately followed, within the
+	 *   block, by complete CMD SELECT messages with valid FCS is not
+	 *   reported. Each of the following CMD SELECT messages may be preceded
+	 *   by a complete CMD EXT_MODE message with valid FCS, which is
+	 *   collapsed with it. Only the last CMD SELECT message in the run is
+	 *   reported, data() points to its payload, and mode_offset() and
+	 *   selected_mode() are those of that message.
+	 * - A SYS ACK message that is immediately followed, within the block,
+	 *   by further SYS ACK messages is reported once.
+	 *
+	 * Messages of any other type end a run, so the ordering of the
+	 * reported messages relative to CMD WRITE messages is preserved.
+	 * Runs are not collapsed across blocks.
+	 *
+	 * @param input pointer to the block of information from the EV3
+	 * @param len length of the block, in bytes
+	 * @param rtn \ref ParserReturn structure that receives the parsing
+	 * information for the last message reported.
+	 * @param stats \ref CoalesceStatistics structure whose counters are
+	 * incremented for every message that was collapsed
+	 * @return number of bytes consumed from \c input
+	 */
+	size_t update_coalesced(const uint8_t* input, size_t len,
+							ParserReturn& rtn, CoalesceStatistics& stats);
+
 	/**
 	 * Obtain a pointer to the data received from the EV3 by the parser.
 	 *
@@ -303,6 +607,8 @@ public:
 	 * RECEIVED_SYS_NACK		 | Meaningless data
 	 * RECEIVED_CMD_SELECT		 | SELECT message's payload
 	 * RECEIVED_CMD_WRITE		 | WRITE message's payload
+	 * RECEIVED_CMD_SPEED		 | SPEED message's payload
+	 * RECEIVED_CMD_EXT_MODE	 | EXT_MODE message's payload
 	 * RECEIVED_CMD_INVALID_FCS	 | Payload of message with invalid FCS
 	 *
 	 * \warning The block of memory pointed to by the returned pointer may be
@@ -325,8 +631,243 @@ public:
 	const uint8_t* data() const;
 
 	/**
-	 * Reset the state of the parser, so that the next byte input into the
-	 * parser will be treated as a <b> header byte </b> candidate.
+	 * Obtain the mode offset that applies to the last CMD SELECT or
+	 * CMD WRITE message received.
+	 *
+	 * The offset is taken from a CMD EXT_MODE message received immediately
+	 * before the CMD SELECT or CMD WRITE message, and is \c 0 if there was
+	 * no such message. Any other message received in between cancels the
+	 * offset.
+	 *
+	 * @pre update() returned a ParserReturn structure that has
+	 * ParserReturn::res set to ParseResult::RECEIVED_CMD_SELECT or
+	 * ParseResult::RECEIVED_CMD_WRITE.
+	 *
+	 * @return mode offset, \c 0 or \c 8
+	 */
+	uint8_t mode_offset() const;
+
+	/**
+	 * Obtain the effective mode selected by the EV3 in a CMD SELECT message,
+	 * i.e. the mode in the message's payload plus mode_offset().
+	 *
+	 * @pre update() returned a ParserReturn structure that has
+	 * ParserReturn::res set to ParseResult::RECEIVED_CMD_SELECT. If this
+	 * precondition is not met, the value returned is meaningless.
+	 *
+	 * @return effective mode selected, in the range [0, 15]
+	 */
+	uint8_t selected_mode() const;
+
+	/**
+	 * Write a snapshot of the state of the parser, so that a parser in
+	 * another process can continue parsing a partially parsed message with
+	 * restore().
+	 *
+	 * The snapshot is SNAPSHOT_HEADER_LEN bytes long, followed by the bytes
+	 * of the partially parsed message, if any. It does not include the
+	 * payload of the message last parsed, so data() is not preserved.
+	 *
+	 * @param out buffer to write the snapshot to, at least
+	 * SNAPSHOT_MAX_LEN bytes long
+	 * @return length of the snapshot, in bytes
+	 */
+	uint8_t snapshot(uint8_t* out) const;
+
+	/**
+	 * Restore the state of the parser from a snapshot written by
+	 * snapshot()
+	 *
+	 * @param in buffer containing the snapshot
+	 * @param len length of the buffer, in bytes. May be longer than the
+	 * snapshot.
+	 * @return length of the snapshot read from \c in, in bytes, or \c 0 if
+	 * the snapshot is truncated, of another version, or inconsistent. The
+	 * state of the parser is not modified if \c 0 is returned.
+	 */
+	size_t restore(const uint8_t* in, size_t len);
+};
+
+/**
+ * Write snapshots of the states of a number of parsers, one after another
+ *
+ * @param parsers pointer to the parsers
+ * @param count number of parsers
+ * @param out buffer to write the snapshots to, at least
+ * \c count * SNAPSHOT_MAX_LEN bytes long
+ * @return length of the snapshots, in bytes
+ */
+size_t snapshot(const Parser* parsers, size_t count, uint8_t* out);
+
+/**
+ * Restore the states of a number of parsers from snapshots written by
+ * snapshot(const Parser*, size_t, uint8_t*)
+ *
+ * @param parsers pointer to the parsers
+ * @param count number of parsers
+ * @param in buffer containing the snapshots
+ * @param len length of the buffer, in bytes
+ * @return length of the snapshots read from \c in, in bytes, or \c 0 if
+ * any snapshot was rejected by Parser::restore(). Parsers preceding the
+ * rejected snapshot are restored.
+ */
+size_t restore(Parser* parsers, size_t count, const uint8_t* in, size_t len);
+
+/**
+ * Number of bytes ResyncParser keeps: the longest message, followed by
+ * messages completed within it and held back until it is resolved
+ */
+constexpr uint8_t RESYNC_WINDOW_LEN { 64 };
+
+/**
+ * Parser for parsing EV3 UART sensor protocol messages that come from the
+ * EV3, which never loses a message with good FCS to a false header byte.
+ *
+ * Parser commits to the first valid header byte it sees, so a noise or
+ * payload byte that happens to be a valid CMD header causes up to 33 of the
+ * bytes following it, possibly including a real message, to be consumed
+ * before the FCS check fails.
+ *
+ * This parser instead tracks every valid CMD header byte received within
+ * the length of the longest message as a separate hypothesis. On every byte,
+ * the hypotheses whose messages end at that byte are checked. A hypothesis
+ * with good FCS is held back while an older hypothesis covering it is
+ * pending, as it may be part of that message's payload: if the older
+ * hypothesis completes with good FCS, it is reported instead, and every
+ * hypothesis it covers is discarded. Held back messages are reported oldest
+ * first, one per call, once no older hypothesis is pending.
+ *
+ * As hypotheses are only resolved by the bytes following them, a message
+ * held back behind a false header byte is not reported until up to 33 more
+ * bytes are received. When the line goes idle, or an out-of-band event
+ * occurs on it, flush() reports the held back messages immediately.
+ *
+ * Results are reported in the same way as by Parser::update(), except that:
+ * - Messages found within a hypothesis that fails its FCS check are
+ *   reported after it fails, in place of
+ *   ParseResult::RECEIVED_CMD_INVALID_FCS for it.
+ * - ParseResult::RECEIVED_CMD_INVALID_FCS is only reported for the oldest
+ *   pending hypothesis, i.e. the message Parser would have parsed.
+ * - ParseResult::RECEIVED_INVALID_HEADER, ParseResult::RECEIVED_SYS_ACK and
+ *   ParseResult::RECEIVED_SYS_NACK are only reported when no hypothesis is
+ *   pending or held back, like Parser does in State::WAIT_HEADER.
+ * - CMD EXT_MODE offsets are not applied to subsequent messages.
+ *
+ * The cost of parsing a byte is proportional to the number of bytes kept,
+ * at most \ref RESYNC_WINDOW_LEN.
+ */
+class ResyncParser {
+private:
+	/**
+	 * Bytes received since the oldest pending or held back hypothesis
+	 * started.
+	 *
+	 * \c window[0] stores the header byte of the oldest pending or held
+	 * back hypothesis. Only the first \ref RESYNC_WINDOW_LEN bytes are
+	 * used, the rest keep the memory area returned by data() as large as
+	 * the one returned by Parser::data() for messages starting at the end
+	 * of the window.
+	 */
+	uint8_t window[RESYNC_WINDOW_LEN + BUFFER_LEN];
+	uint8_t window_length = 0;
+	/**
+	 * Pending hypotheses. Bit \c i is set if a message starting at
+	 * \c window[i] has not been completed yet
+	 */
+	uint64_t hypotheses = 0;
+	/**
+	 * Held back hypotheses. Bit \c i is set if a message starting at
+	 * \c window[i] was completed with good FCS, but has not been reported
+	 * yet, as an older pending hypothesis covers it
+	 */
+	uint64_t completed = 0;
+	/**
+	 * Index in \ref window of the header byte of the message last reported
+	 */
+	uint8_t message_offset = 0;
+
+	/**
+	 * Drop bytes from the start of \ref window that are no longer part of
+	 * any pending or held back hypothesis. If \ref window is still full,
+	 * the oldest hypothesis is dropped to make room.
+	 *
+	 * Deferred to the start of update(), so that the memory area returned by
+	 * data() stays valid until the next call to update().
+	 */
+	void compact();
+
+	/**
+	 * Report the oldest message held back, if no hypothesis covering it is
+	 * pending, and discard every hypothesis it covers
+	 *
+	 * @param rtn \ref ParserReturn structure that receives the message
+	 * reported, left unmodified if no message is reported
+	 * @return \c true if a message was reported
+	 */
+	bool release(ParserReturn& rtn);
+public:
+	ResyncParser();
+	ResyncParser(const ResyncParser&) = delete;
+
+	/**
+	 * Update the parser with one byte of information from the EV3
+	 *
+	 * @param input byte of information from the EV3
+	 * @return \ref ParserReturn structure containing parsing information
+	 */
+	ParserReturn update(uint8_t input);
+
+	/**
+	 * Obtain a pointer to the data received from the EV3 by the parser,
+	 * with the same meaning and constraints as Parser::data()
+	 *
+	 * @return pointer to the payload of the message last reported
+	 */
+	uint8_t* data();
+
+	/**
+	 * Provides the same functionality as the similarly named function,
+	 * except that it returns a pointer to a memory region that cannot
+	 * be modified.
+	 *
+	 * @return pointer to the payload of the message last reported
+	 */
+	const uint8_t* data() const;
+
+	/**
+	 * Inform the parser of an out-of-band event on the line, with the same
+	 * semantics as Parser::line_event().
+	 *
+	 * Every pending hypothesis is abandoned, as the messages they stand for
+	 * cannot be completed anymore. Messages held back behind them are kept,
+	 * and should be retrieved with flush().
+	 *
+	 * @param ev event that occurred on the line
+	 * @retval true a pending hypothesis was abandoned
+	 * @retval false no hypothesis was pending
+	 */
+	bool line_event(LineEvent ev);
+
+	/**
+	 * Report messages held back behind hypotheses that cannot be resolved,
+	 * e.g. when no more bytes were received for an inter-byte timeout.
+	 *
+	 * Every pending hypothesis is abandoned, and the oldest message held
+	 * back is reported, as if update() had returned it. Call this function
+	 * until it returns ParseResult::INSUFFICIENT_DATA to report every
+	 * message held back.
+	 *
+	 * @return \ref ParserReturn structure containing the message reported,
+	 * with ParserReturn::res set to ParseResult::INSUFFICIENT_DATA if no
+	 * message was held back
+	 */
+	ParserReturn flush();
+
+	/**
+	 * Reset the state of the parser, discarding all pending and held back
+	 * hypotheses, so that the next byte input into the parser will be
+	 * treated as a
+	 * <b> header byte </b> candidate.
 	 */
 	void reset_state();
 };
@@ -0,0 +1,68 @@
+/**
+ * \file EV3UartSniffer.cpp
+ *
+ * Definitions for the sniffer decoding both directions of a tapped
+ * connection
+ *
+ * \copyright Shenghao Yang, 2018
+ *
+ * See LICENSE for details
+ */
+
+#include <EV3UartSniffer.hpp>
+#include <stdint.h>
+
+namespace EV3UartProtocolParserSensorSide {
+
+Sniffer::Sniffer() {
+
+}
+
+size_t Sniffer::update_from_ev3(const uint8_t* input, size_t len,
+								uint32_t now, ParserReturn& rtn) {
+	const size_t consumed { ev3_parser.update(input, len, rtn) };
+
+	if (rtn.res == ParseResult::RECEIVED_SYS_NACK) {
+		if (nack_outstanding)
+			latency.unanswered += 1;
+		nack_time = now;
+		nack_outstanding = true;
+	}
+
+	return consumed;
+}
+
+size_t Sniffer::update_from_sensor(const uint8_t* input, size_t len,
+								   uint32_t now, HostParserReturn& rtn) {
+	const size_t consumed { sensor_parser.update(input, len, rtn) };
+
+	if ((rtn.res == HostParseResult::RECEIVED_DATA) && nack_outstanding) {
+		latency.last = (now - nack_time);
+		if (latency.last > latency.max)
+			latency.max = latency.last;
+		latency.replies += 1;
+		nack_outstanding = false;
+	}
+
+	return consumed;
+}
+
+const NackLatency& Sniffer::nack_latency() const {
+	return latency;
+}
+
+const Parser& Sniffer::ev3() const {
+	return ev3_parser;
+}
+
+const HostParser& Sniffer::sensor() const {
+	return sensor_parser;
+}
+
+void Sniffer::reset() {
+	ev3_parser.reset_state();
+	sensor_parser.reset_state();
+	latency = NackLatency { };
+	nack_outstanding = false;
+}
+}
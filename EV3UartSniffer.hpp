@@ -0,0 +1,124 @@
+/**
+ * \file EV3UartSniffer.hpp
+ *
+ * Header file for the sniffer decoding both directions of a tapped
+ * connection between the EV3 and a sensor
+ *
+ * \copyright Shenghao Yang, 2018
+ *
+ * See LICENSE for details
+ */
+
+#ifndef EV3UARTSNIFFER_HPP_
+#define EV3UARTSNIFFER_HPP_
+
+#include <EV3UartProtocolParserSensorSide.hpp>
+#include <EV3UartProtocolParserHostSide.hpp>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace EV3UartProtocolParserSensorSide {
+
+/**
+ * Structure containing the latency between the SYS NACK messages sent by
+ * the EV3 and the DATA messages the sensor sent in reply, measured by
+ * Sniffer.
+ *
+ * Latencies are in the unit of the timestamps passed to Sniffer.
+ */
+struct NackLatency {
+	uint32_t last;		 ///< Latency of the last reply
+	uint32_t max;		 ///< Largest latency observed
+	uint32_t replies;	 ///< Number of SYS NACK messages replied to
+	/**
+	 * Number of SYS NACK messages followed by another SYS NACK message
+	 * before the sensor replied
+	 */
+	uint32_t unanswered;
+};
+
+/**
+ * Sniffer decoding both directions of a tapped connection, with a Parser
+ * for the messages from the EV3 and a HostParser for the messages from the
+ * sensor, and correlating the two streams.
+ *
+ * Each direction is fed blocks of bytes with the time they were received,
+ * in any unit, from a free running counter that wraps around at \c 2^32.
+ * The first DATA message with good FCS received after a SYS NACK message
+ * is taken as the reply to it.
+ *
+ * The latency measured includes the time the bytes spent in the UART
+ * backends, so blocks should be timestamped as soon as they are received.
+ */
+class Sniffer {
+private:
+	Parser ev3_parser;
+	HostParser sensor_parser;
+	NackLatency latency { };
+	uint32_t nack_time = 0;
+	bool nack_outstanding = false;
+public:
+	Sniffer();
+	Sniffer(const Sniffer&) = delete;
+
+	/**
+	 * Update the sniffer with a block of information sent by the EV3, with
+	 * the same semantics as
+	 * Parser::update(const uint8_t*, size_t, ParserReturn&)
+	 *
+	 * @param input pointer to the block of information from the EV3
+	 * @param len length of the block, in bytes
+	 * @param now time the block was received
+	 * @param rtn \ref ParserReturn structure that receives the parsing
+	 * information for the last byte consumed
+	 * @return number of bytes consumed from \c input
+	 */
+	size_t update_from_ev3(const uint8_t* input, size_t len, uint32_t now,
+						   ParserReturn& rtn);
+
+	/**
+	 * Update the sniffer with a block of information sent by the sensor,
+	 * with the same semantics as
+	 * HostParser::update(const uint8_t*, size_t, HostParserReturn&)
+	 *
+	 * @param input pointer to the block of information from the sensor
+	 * @param len length of the block, in bytes
+	 * @param now time the block was received
+	 * @param rtn \ref HostParserReturn structure that receives the parsing
+	 * information for the last byte consumed
+	 * @return number of bytes consumed from \c input
+	 */
+	size_t update_from_sensor(const uint8_t* input, size_t len, uint32_t now,
+							  HostParserReturn& rtn);
+
+	/**
+	 * Obtain the latency between SYS NACK messages and their replies
+	 *
+	 * @return reference to the latency statistics
+	 */
+	const NackLatency& nack_latency() const;
+
+	/**
+	 * Obtain the parser for messages from the EV3, e.g. to access the
+	 * payload of the message last parsed
+	 *
+	 * @return reference to the parser
+	 */
+	const Parser& ev3() const;
+
+	/**
+	 * Obtain the parser for messages from the sensor
+	 *
+	 * @return reference to the parser
+	 */
+	const HostParser& sensor() const;
+
+	/**
+	 * Reset the state of both parsers and the latency statistics, e.g.
+	 * when the tapped connection has been reset
+	 */
+	void reset();
+};
+}
+
+#endif /* EV3UARTSNIFFER_HPP_ */
@@ -0,0 +1,133 @@
+/**
+ * \file EV3UartTimerWheelSensorSide.cpp
+ *
+ * Definitions for the hierarchical timer wheel
+ *
+ * \copyright Shenghao Yang, 2018
+ *
+ * See LICENSE for details
+ */
+
+#include <EV3UartTimerWheelSensorSide.hpp>
+#include <stdint.h>
+
+namespace EV3UartProtocolParserSensorSide {
+
+namespace {
+
+/**
+ * Number of bits of a tick selecting the slot in the first level
+ */
+constexpr uint8_t NEAR_BITS { 8 };
+
+static_assert(TIMER_WHEEL_NEAR_SLOTS == (1 << NEAR_BITS),
+			  "first level must have a slot per value of the low tick bits");
+static_assert((TIMER_WHEEL_FAR_SLOTS & (TIMER_WHEEL_FAR_SLOTS - 1)) == 0,
+			  "second level must have a power of two number of slots");
+
+constexpr uint32_t NEAR_MASK { TIMER_WHEEL_NEAR_SLOTS - 1 };
+constexpr uint32_t FAR_MASK { TIMER_WHEEL_FAR_SLOTS - 1 };
+
+/**
+ * Check whether tick \c a is after tick \c b, accounting for wrap around
+ */
+constexpr bool after(uint32_t a, uint32_t b) {
+	return static_cast<int32_t>(a - b) > 0;
+}
+}
+
+TimerWheel::TimerWheel(uint32_t now) : current { now } {
+
+}
+
+void TimerWheel::link(TimerNode*& head, TimerNode& node) {
+	node.next = head;
+	if (head)
+		head->pprev = &node.next;
+	head = &node;
+	node.pprev = &head;
+}
+
+void TimerWheel::unlink(TimerNode& node) {
+	*node.pprev = node.next;
+	if (node.next)
+		node.next->pprev = node.pprev;
+	node.next = nullptr;
+	node.pprev = nullptr;
+}
+
+void TimerWheel::file(TimerNode& node, uint32_t base) {
+	const uint32_t delta { node.deadline - base };
+
+	if (after(base, node.deadline)) {
+		// Already due - expire on the first tick not processed
+		link(near_slots[base & NEAR_MASK], node);
+	} else if (delta < TIMER_WHEEL_NEAR_SLOTS) {
+		link(near_slots[node.deadline & NEAR_MASK], node);
+	} else if (delta < TIMER_WHEEL_SPAN) {
+		link(far_slots[(node.deadline >> NEAR_BITS) & FAR_MASK], node);
+	} else {
+		// Beyond the span of the wheel - park in the slot that comes around
+		// last before the deadline, and file again from there
+		const uint32_t parked { base + TIMER_WHEEL_SPAN - 1 };
+		link(far_slots[(parked >> NEAR_BITS) & FAR_MASK], node);
+	}
+}
+
+void TimerWheel::arm(TimerNode& node, uint32_t deadline) {
+	if (node.armed())
+		unlink(node);
+	node.deadline = deadline;
+	file(node, current + 1);
+}
+
+void TimerWheel::cancel(TimerNode& node) {
+	if (node.armed())
+		unlink(node);
+}
+
+size_t TimerWheel::advance(uint32_t now) {
+	size_t expired { 0 };
+
+	while (after(now, current)) {
+		current += 1;
+
+		// Detach each slot before processing it, so that timers armed or
+		// cancelled by callbacks never affect the list being walked
+		TimerNode* pending { nullptr };
+
+		if (!(current & NEAR_MASK)) {
+			// Move the timers in the second level slot that came around
+			// into the first level
+			TimerNode*& slot { far_slots[(current >> NEAR_BITS) & FAR_MASK] };
+			pending = slot;
+			slot = nullptr;
+			if (pending)
+				pending->pprev = &pending;
+			while (pending) {
+				TimerNode& node { *pending };
+				unlink(node);
+				file(node, current);
+			}
+		}
+
+		TimerNode*& slot { near_slots[current & NEAR_MASK] };
+		pending = slot;
+		slot = nullptr;
+		if (pending)
+			pending->pprev = &pending;
+		while (pending) {
+			TimerNode& node { *pending };
+			unlink(node);
+			node.callback(node.context, node);
+			expired += 1;
+		}
+	}
+
+	return expired;
+}
+
+uint32_t TimerWheel::now() const {
+	return current;
+}
+}
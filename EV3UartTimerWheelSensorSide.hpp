@@ -0,0 +1,197 @@
+/**
+ * \file EV3UartTimerWheelSensorSide.hpp
+ *
+ * Header file for the hierarchical timer wheel driving the timeouts of a
+ * large number of links
+ *
+ * \copyright Shenghao Yang, 2018
+ *
+ * See LICENSE for details
+ */
+
+#ifndef EV3UARTTIMERWHEELSENSORSIDE_HPP_
+#define EV3UARTTIMERWHEELSENSORSIDE_HPP_
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace EV3UartProtocolParserSensorSide {
+
+/**
+ * Number of slots in the first level of a TimerWheel, each covering one
+ * tick
+ */
+constexpr uint16_t TIMER_WHEEL_NEAR_SLOTS { 256 };
+
+/**
+ * Number of slots in the second level of a TimerWheel, each covering
+ * \ref TIMER_WHEEL_NEAR_SLOTS ticks
+ */
+constexpr uint16_t TIMER_WHEEL_FAR_SLOTS { 64 };
+
+/**
+ * Number of ticks ahead a timer can be armed without being re-filed into
+ * the second level of a TimerWheel when it comes around
+ */
+constexpr uint32_t TIMER_WHEEL_SPAN {
+	static_cast<uint32_t>(TIMER_WHEEL_NEAR_SLOTS) * TIMER_WHEEL_FAR_SLOTS
+};
+
+struct TimerNode;
+
+/**
+ * Callback invoked by TimerWheel::advance() for every timer that expires
+ *
+ * The timer is no longer armed when the callback is invoked, and may be
+ * armed again by the callback, e.g. for periodic keepalives. Other timers
+ * may be armed or cancelled by the callback.
+ *
+ * @param context context pointer stored in the timer
+ * @param node timer that expired
+ */
+typedef void (*TimerCallback)(void* context, TimerNode& node);
+
+/**
+ * Timer managed by a TimerWheel.
+ *
+ * Timers are intrusive: they are allocated by the application, typically
+ * as members of the per-link structures they time out, and are linked into
+ * the wheel directly, so arming and cancelling them never allocates.
+ */
+struct TimerNode {
+	TimerNode* next = nullptr;
+	/**
+	 * Pointer to the pointer pointing to this timer, \c nullptr if the timer
+	 * is not armed
+	 */
+	TimerNode** pprev = nullptr;
+	uint32_t deadline = 0;		   ///< Tick the timer expires at
+	TimerCallback callback = nullptr; ///< Callback invoked on expiry
+	void* context = nullptr;	   ///< Context pointer passed to the callback
+
+	/**
+	 * Check whether the timer is armed
+	 *
+	 * @return \c true if the timer is armed, \c false otherwise
+	 */
+	bool armed() const {
+		return (pprev != nullptr);
+	}
+};
+
+/**
+ * Two-level hierarchical timer wheel.
+ *
+ * Arming and cancelling a timer take constant time. Timers due within
+ * \ref TIMER_WHEEL_NEAR_SLOTS ticks are filed into a slot per tick; timers
+ * due later are filed into a slot per \ref TIMER_WHEEL_NEAR_SLOTS ticks,
+ * and are moved into the first level when their slot comes around.
+ *
+ * advance() is called once per event loop iteration. Its cost is
+ * proportional to the number of ticks elapsed and the number of timers
+ * expired or moved, and does not depend on the number of timers armed.
+ * \code{.cpp}
+ * struct Port {
+ *     Parser parser;
+ *     TimerNode inter_byte;
+ * };
+ *
+ * void inter_byte_expired(void* context, TimerNode& node) {
+ *     static_cast<Port*>(context)->parser.line_event(LineEvent::TIMEOUT);
+ * }
+ *
+ * TimerWheel wheel { millis() };
+ * // For each port
+ * port.inter_byte.callback = inter_byte_expired;
+ * port.inter_byte.context = &port;
+ * // After feeding bytes to the parser of a port
+ * if (message_partially_received)
+ *     wheel.arm(port.inter_byte, millis() + INTER_BYTE_TIMEOUT);
+ * else
+ *     wheel.cancel(port.inter_byte);
+ * // Once per event loop iteration
+ * wheel.advance(millis());
+ * \endcode
+ *
+ * Ticks are in the unit of the timestamps passed to the wheel, taken from
+ * a free running counter that wraps around at \c 2^32. Timers may be armed
+ * up to \c 2^31 ticks ahead.
+ */
+class TimerWheel {
+private:
+	TimerNode* near_slots[TIMER_WHEEL_NEAR_SLOTS] = { };
+	TimerNode* far_slots[TIMER_WHEEL_FAR_SLOTS] = { };
+	/**
+	 * Last tick processed by advance()
+	 */
+	uint32_t current;
+
+	/**
+	 * File an unlinked timer into the slot for its deadline
+	 *
+	 * @param node timer to file
+	 * @param base first tick whose first level slot has not been processed
+	 */
+	void file(TimerNode& node, uint32_t base);
+
+	/**
+	 * Link a timer at the head of a list
+	 *
+	 * @param head head of the list
+	 * @param node timer to link
+	 */
+	static void link(TimerNode*& head, TimerNode& node);
+
+	/**
+	 * Unlink an armed timer from the list it is in
+	 *
+	 * @param node timer to unlink
+	 */
+	static void unlink(TimerNode& node);
+public:
+	/**
+	 * Construct a timer wheel
+	 *
+	 * @param now current tick
+	 */
+	explicit TimerWheel(uint32_t now);
+	TimerWheel(const TimerWheel&) = delete;
+
+	/**
+	 * Arm a timer, re-arming it if it is already armed
+	 *
+	 * A timer armed with a deadline that is not after the last tick
+	 * processed expires on the next call to advance() that processes a tick.
+	 *
+	 * @param node timer to arm. TimerNode::callback must be set.
+	 * @param deadline tick the timer expires at
+	 */
+	void arm(TimerNode& node, uint32_t deadline);
+
+	/**
+	 * Cancel a timer. Cancelling a timer that is not armed has no effect.
+	 *
+	 * @param node timer to cancel
+	 */
+	void cancel(TimerNode& node);
+
+	/**
+	 * Process every tick after the last tick processed, up to and including
+	 * \c now, expiring the timers due at those ticks.
+	 *
+	 * @param now current tick
+	 * @return number of timers expired
+	 */
+	size_t advance(uint32_t now);
+
+	/**
+	 * Obtain the last tick processed
+	 *
+	 * @return last tick processed by advance(), or the tick the wheel was
+	 * constructed with
+	 */
+	uint32_t now() const;
+};
+}
+
+#endif /* EV3UARTTIMERWHEELSENSORSIDE_HPP_ */
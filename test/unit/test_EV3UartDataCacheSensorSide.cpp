@@ -0,0 +1,124 @@
+/**
+ * \file test_EV3UartDataCacheSensorSide.cpp
+ *
+ * Unit tests for functionality contained in EV3UartDataCacheSensorSide.cpp
+ *
+ * The tests in this file verify that the cache:
+ * - Frames DATA messages with the right header, padding and FCS
+ * - Precedes DATA messages for modes 8 - 15 with a CMD EXT_MODE message
+ * - Patches readings with the same result as framing them again
+ * - Rejects out of range modes, lengths and patches
+ *
+ * \copyright Shenghao Yang, 2018
+ * 
+ * See LICENSE for details
+ */
+
+#include <EV3UartDataCacheSensorSide.hpp>
+#include <EV3UartGenerator.hpp>
+#include "catch.hpp"
+#include <algorithm>
+#include <array>
+#include <numeric>
+
+using namespace EV3UartGenerator;
+using namespace EV3UartProtocolParserSensorSide;
+
+TEST_CASE("DataCache frames DATA messages", "[DataCache]") {
+	DataCache c { };
+	for (uint8_t mode = 0; mode < DATA_CACHE_MODES; mode++)
+		REQUIRE(c.frame_length(mode) == 0);
+
+	for (uint8_t len = 1; len <= 0x20; len++) {
+		std::array<uint8_t, 0x20> payload;
+		std::iota(payload.begin(), payload.end(), 0x01);
+		const uint8_t mode = (len % DATA_CACHE_MODES);
+		REQUIRE(c.set(mode, payload.data(), len));
+
+		const uint8_t payload_length { two_pow(Framing::log2(len)) };
+		const uint8_t prefix { (mode >= 8) ? EXT_MODE_PREFIX_LEN : 0 };
+		const uint8_t* frame { c.frame(mode) + prefix };
+		CAPTURE(static_cast<int>(mode));
+		REQUIRE(c.frame_length(mode) == (prefix + payload_length + 2));
+		REQUIRE(frame[0] == (static_cast<uint8_t>(Magics::DATA::DATA_BASE)
+							 | (Framing::log2(len) << 3) | (mode & 0x07)));
+		REQUIRE(std::equal(payload.begin(), payload.begin() + len,
+						   frame + 1));
+		REQUIRE(std::all_of(frame + 1 + len, frame + 1 + payload_length,
+				[](const uint8_t b) { return b == 0x00; }));
+		REQUIRE(frame[payload_length + 1]
+				== Framing::checksum(frame, payload_length + 1));
+	}
+
+	SECTION("DATA messages for modes 8 - 15 follow a CMD EXT_MODE message") {
+		for (uint8_t mode = 0; mode < DATA_CACHE_MODES; mode++) {
+			const uint8_t reading[1] { mode };
+			REQUIRE(c.set(mode, reading, sizeof(reading)));
+			const uint8_t* frame { c.frame(mode) };
+			CAPTURE(static_cast<int>(mode));
+			if (mode < 8) {
+				REQUIRE(c.frame_length(mode) == 3);
+				continue;
+			}
+
+			REQUIRE(c.frame_length(mode) == (EXT_MODE_PREFIX_LEN + 3));
+			REQUIRE(frame[0] == (static_cast<uint8_t>(Magics::CMD::CMD_BASE)
+								 | CMD_EXT_MODE));
+			REQUIRE(frame[1] == 0x08);
+			REQUIRE(frame[2] == Framing::checksum(frame, 2));
+			REQUIRE(frame[3] == (static_cast<uint8_t>(Magics::DATA::DATA_BASE)
+								 | (mode - 8)));
+			REQUIRE(frame[4] == mode);
+			REQUIRE(frame[5] == Framing::checksum(frame + 3, 2));
+		}
+	}
+
+	SECTION("Out of range modes and lengths are rejected") {
+		const uint8_t payload[0x21] { };
+		REQUIRE(!c.set(DATA_CACHE_MODES, payload, 1));
+		REQUIRE(!c.set(0, payload, 0));
+		REQUIRE(!c.set(0, payload, 0x21));
+		REQUIRE(c.frame(DATA_CACHE_MODES) == nullptr);
+		REQUIRE(c.frame_length(DATA_CACHE_MODES) == 0);
+	}
+}
+
+TEST_CASE("DataCache patches readings incrementally", "[DataCache]") {
+	DataCache patched { };
+	DataCache reference { };
+	uint8_t reading[8] { 1, 2, 3, 4, 5, 6, 7, 8 };
+	REQUIRE(patched.set(2, reading, sizeof(reading)));
+
+	const uint8_t values[3] { 0xaa, 0x55, 0xff };
+	REQUIRE(patched.update(2, 4, values, sizeof(values)));
+	std::copy(values, values + sizeof(values), reading + 4);
+	REQUIRE(reference.set(2, reading, sizeof(reading)));
+
+	REQUIRE(patched.frame_length(2) == reference.frame_length(2));
+	REQUIRE(std::equal(reference.frame(2),
+					   reference.frame(2) + reference.frame_length(2),
+					   patched.frame(2)));
+
+	SECTION("Readings for modes 8 - 15 are patched after the CMD EXT_MODE "
+			"message") {
+		REQUIRE(patched.set(10, reading, sizeof(reading)));
+		REQUIRE(patched.update(10, 0, values, sizeof(values)));
+		std::copy(values, values + sizeof(values), reading);
+		REQUIRE(reference.set(10, reading, sizeof(reading)));
+		REQUIRE(patched.frame_length(10) == reference.frame_length(10));
+		REQUIRE(std::equal(reference.frame(10),
+						   reference.frame(10) + reference.frame_length(10),
+						   patched.frame(10)));
+		REQUIRE(!patched.update(10, 6, values, sizeof(values)));
+	}
+
+	SECTION("Patches outside the payload are rejected") {
+		REQUIRE(!patched.update(2, 6, values, sizeof(values)));
+		REQUIRE(!patched.update(2, 9, values, 0));
+		REQUIRE(!patched.update(3, 0, values, 1));
+		REQUIRE(!patched.update(DATA_CACHE_MODES, 0, values, 1));
+		REQUIRE(std::equal(reference.frame(2),
+						   reference.frame(2) + reference.frame_length(2),
+						   patched.frame(2)));
+	}
+}
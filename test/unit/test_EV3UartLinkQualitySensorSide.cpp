@@ -0,0 +1,164 @@
+/**
+ * \file test_EV3UartLinkQualitySensorSide.cpp
+ *
+ * Unit tests for functionality contained in EV3UartLinkQualitySensorSide.cpp
+ *
+ * The tests in this file verify that:
+ * - The estimator tracks invalid header and invalid FCS rates
+ * - The policy requires no action on a healthy line, resets the parser or
+ *   restarts the handshake on a noisy line, and drops the speed on a
+ *   mis-clocked line
+ * - The link keeps its estimates up to date as it parses
+ *
+ * \copyright Shenghao Yang, 2018
+ * 
+ * See LICENSE for details
+ */
+
+#include <EV3UartLinkQualitySensorSide.hpp>
+#include <EV3UartLinkSensorSide.hpp>
+#include <EV3UartGenerator.hpp>
+#include "catch.hpp"
+#include <array>
+#include <vector>
+
+using namespace EV3UartGenerator;
+using namespace EV3UartProtocolParserSensorSide;
+
+namespace {
+
+/**
+ * Parse a stream of CMD SELECT messages, every \c bad_every th message having
+ * an invalid FCS (none if \c 0), and update \c q with the results
+ */
+void parse_selects(LinkQuality& q, uint32_t count, uint32_t bad_every) {
+	Parser p { };
+	for (uint32_t i = 0; i < count; i++) {
+		std::array<uint8_t, Framing::BUFFER_MIN> buffer;
+		const uint8_t frame_size {
+			Framing::frame_cmd_select_message(buffer.data(), i % 8)
+		};
+		if (bad_every && ((i % bad_every) == 0))
+			buffer[frame_size - 1] += 0x01;
+
+		const uint8_t* block { buffer.data() };
+		size_t len { frame_size };
+		while (len) {
+			ParserReturn rtn { };
+			const size_t consumed { p.update(block, len, rtn) };
+			q.update(rtn.res, consumed);
+			block += consumed;
+			len -= consumed;
+		}
+	}
+}
+}
+
+TEST_CASE("rate_from_percent() returns correct results",
+		  "[rate_from_percent()]") {
+	REQUIRE(rate_from_percent(0) == 0);
+	REQUIRE(rate_from_percent(50) == (RATE_ONE / 2));
+	REQUIRE(rate_from_percent(100) == RATE_ONE);
+}
+
+TEST_CASE("LinkPolicy acts on the estimates of LinkQuality",
+		  "[LinkQuality] [LinkPolicy]") {
+	LinkQuality q { };
+
+	SECTION("No action is taken before enough bytes are observed") {
+		q.update(ParseResult::RECEIVED_INVALID_HEADER, 1);
+		REQUIRE(q.observed() == 1);
+		REQUIRE(q.invalid_header_rate() > 0);
+		REQUIRE(DEFAULT_LINK_POLICY.evaluate(q) == LinkAction::NONE);
+	}
+
+	SECTION("Healthy lines require no action") {
+		parse_selects(q, 200, 0);
+		REQUIRE(q.invalid_header_rate() == 0);
+		REQUIRE(q.invalid_fcs_rate() == 0);
+		REQUIRE(DEFAULT_LINK_POLICY.evaluate(q) == LinkAction::NONE);
+	}
+
+	SECTION("Noisy lines reset the parser") {
+		parse_selects(q, 200, 3);
+		REQUIRE(q.invalid_header_rate() == 0);
+		REQUIRE(DEFAULT_LINK_POLICY.evaluate(q) == LinkAction::RESET_PARSER);
+	}
+
+	SECTION("Very noisy lines restart the handshake") {
+		parse_selects(q, 200, 1);
+		REQUIRE(q.invalid_fcs_rate() > rate_from_percent(90));
+		REQUIRE(DEFAULT_LINK_POLICY.evaluate(q)
+				== LinkAction::RESTART_HANDSHAKE);
+	}
+
+	SECTION("Mis-clocked lines drop the speed") {
+		// Two in five bytes are invalid header bytes
+		for (uint32_t i = 0; i < 512; i++)
+			q.update(((i % 5) < 2) ? ParseResult::RECEIVED_INVALID_HEADER
+								   : ParseResult::RECEIVED_SYS_NACK, 1);
+		REQUIRE(q.invalid_header_rate() > rate_from_percent(30));
+		REQUIRE(DEFAULT_LINK_POLICY.evaluate(q) == LinkAction::DROP_SPEED);
+
+		q.reset();
+		REQUIRE(q.observed() == 0);
+		REQUIRE(q.invalid_header_rate() == 0);
+		REQUIRE(DEFAULT_LINK_POLICY.evaluate(q) == LinkAction::NONE);
+	}
+
+	SECTION("Lines at the mis-clocked rate drop the speed within a window") {
+		// Three in ten bytes are invalid header bytes
+		uint32_t fired_at { 0 };
+		for (uint32_t i = 0; (i < 2000) && (!fired_at); i++) {
+			q.update(((i % 10) < 3) ? ParseResult::RECEIVED_INVALID_HEADER
+									: ParseResult::RECEIVED_SYS_NACK, 1);
+			if (DEFAULT_LINK_POLICY.evaluate(q) == LinkAction::DROP_SPEED)
+				fired_at = q.observed();
+		}
+		REQUIRE(fired_at >= DEFAULT_LINK_POLICY.min_observed);
+		REQUIRE(fired_at <= (HEADER_WINDOW_LEN + 10));
+	}
+
+	SECTION("Lines below the mis-clocked rate do not drop the speed") {
+		// One in four bytes is an invalid header byte
+		for (uint32_t i = 0; i < 2000; i++) {
+			q.update(((i % 4) == 0) ? ParseResult::RECEIVED_INVALID_HEADER
+									: ParseResult::RECEIVED_SYS_NACK, 1);
+			CAPTURE(i);
+			REQUIRE(DEFAULT_LINK_POLICY.evaluate(q) != LinkAction::DROP_SPEED);
+		}
+		REQUIRE(q.invalid_header_rate() == rate_from_percent(25));
+	}
+
+	SECTION("The invalid header rate only counts the last window of bytes") {
+		for (uint32_t i = 0; i < HEADER_WINDOW_LEN; i++)
+			q.update(ParseResult::RECEIVED_INVALID_HEADER, 1);
+		REQUIRE(q.invalid_header_rate() == RATE_ONE);
+
+		// Blocks evict the window as bytes would
+		q.update(ParseResult::RECEIVED_CMD_WRITE, HEADER_WINDOW_LEN / 2);
+		REQUIRE(q.invalid_header_rate() == (RATE_ONE / 2));
+		q.update(ParseResult::RECEIVED_CMD_WRITE, 1000);
+		REQUIRE(q.invalid_header_rate() == 0);
+	}
+}
+
+TEST_CASE("Link updates its line quality estimates", "[Link] [LinkQuality]") {
+	const uint8_t burst[1] { static_cast<uint8_t>(Magics::SYS::ACK) };
+	Link l { burst, sizeof(burst), 57600 };
+	l.handshake_sent();
+
+	const std::vector<uint8_t> garbage(300,
+		static_cast<uint8_t>(Magics::DATA::DATA_BASE));
+	size_t offset { 0 };
+	while (offset < garbage.size()) {
+		LinkReturn rtn { };
+		offset += l.update(garbage.data() + offset, garbage.size() - offset,
+						   rtn);
+	}
+
+	REQUIRE(l.quality().observed() == garbage.size());
+	REQUIRE(DEFAULT_LINK_POLICY.evaluate(l.quality()) == LinkAction::DROP_SPEED);
+	l.reset();
+	REQUIRE(l.quality().observed() == 0);
+}
@@ -0,0 +1,223 @@
+/**
+ * \file test_EV3UartLinkSensorSide.cpp
+ *
+ * Unit tests for functionality contained in EV3UartLinkSensorSide.cpp
+ *
+ * The tests in this file verify that the link:
+ * - Hands out the pre-framed handshake burst unmodified
+ * - Switches to data mode as soon as the EV3's SYS ACK message is parsed
+ * - Leaves bytes following the SYS ACK message unconsumed
+ * - Tracks the selected mode and requests DATA messages on SYS NACK
+ * - Restarts the handshake when it is not acknowledged in time or when the
+ *   EV3 goes silent, and reconnects when the EV3 is plugged back in
+ * - Steps the data speed down when the line carries only garbage
+ * - Returns to the handshake state when reset
+ *
+ * \copyright Shenghao Yang, 2018
+ * 
+ * See LICENSE for details
+ */
+
+#include <EV3UartLinkSensorSide.hpp>
+#include <EV3UartGenerator.hpp>
+#include "catch.hpp"
+#include <array>
+#include <vector>
+
+using namespace EV3UartGenerator;
+using namespace EV3UartProtocolParserSensorSide;
+
+TEST_CASE("Link sequences the handshake with the EV3", "[Link]") {
+	// Minimal handshake burst: CMD SPEED followed by SYS ACK
+	std::array<uint8_t, Framing::BUFFER_MIN * 2> burst { };
+	uint8_t burst_length { 0 };
+	burst_length += Framing::frame_cmd_speed_message(burst.data(), 115200);
+	burst_length += Framing::frame_sys_message(burst.data() + burst_length,
+											   Magics::SYS::ACK);
+
+	Link l { burst.data(), burst_length, 115200 };
+	REQUIRE(l.state() == LinkState::HANDSHAKE);
+	REQUIRE(l.handshake() == burst.data());
+	REQUIRE(l.handshake_length() == burst_length);
+	REQUIRE(l.data_speed() == 115200);
+
+	l.handshake_sent();
+	REQUIRE(l.state() == LinkState::WAIT_ACK);
+
+	// EV3 sends a NACK, then its ACK, followed by a SELECT at the new speed
+	std::array<uint8_t, Framing::BUFFER_MIN * 2> input { };
+	uint8_t input_length { 0 };
+	input_length += Framing::frame_sys_message(input.data(), Magics::SYS::NACK);
+	input_length += Framing::frame_sys_message(input.data() + input_length,
+											   Magics::SYS::ACK);
+	const uint8_t select_offset { input_length };
+	input_length += Framing::frame_cmd_select_message(
+			input.data() + input_length, 0x01);
+
+	LinkReturn rtn { };
+	size_t consumed { l.update(input.data(), input_length, rtn) };
+	REQUIRE(consumed == 1);
+	REQUIRE(rtn.msg.res == ParseResult::RECEIVED_SYS_NACK);
+	REQUIRE(rtn.event == LinkEvent::NONE);
+	REQUIRE(l.state() == LinkState::WAIT_ACK);
+
+	consumed += l.update(input.data() + consumed, input_length - consumed, rtn);
+	REQUIRE(consumed == select_offset);
+	REQUIRE(rtn.msg.res == ParseResult::RECEIVED_SYS_ACK);
+	REQUIRE(rtn.event == LinkEvent::SWITCH_SPEED);
+	REQUIRE(l.state() == LinkState::DATA);
+
+	consumed += l.update(input.data() + consumed, input_length - consumed, rtn);
+	REQUIRE(consumed == input_length);
+	REQUIRE(rtn.msg.res == ParseResult::RECEIVED_CMD_SELECT);
+	REQUIRE(rtn.event == LinkEvent::NONE);
+	REQUIRE(*(l.parser().data()) == 0x01);
+	REQUIRE(l.mode() == 0x01);
+
+	SECTION("SYS ACK messages in data mode do not switch speed again") {
+		l.update(input.data() + 1, 1, rtn);
+		REQUIRE(rtn.msg.res == ParseResult::RECEIVED_SYS_ACK);
+		REQUIRE(rtn.event == LinkEvent::NONE);
+	}
+
+	SECTION("SYS NACK messages in data mode request DATA messages") {
+		l.update(input.data(), 1, rtn);
+		REQUIRE(rtn.msg.res == ParseResult::RECEIVED_SYS_NACK);
+		REQUIRE(rtn.event == LinkEvent::SEND_DATA);
+	}
+
+	SECTION("Link returns to the handshake state when reset") {
+		l.reset();
+		REQUIRE(l.state() == LinkState::HANDSHAKE);
+		REQUIRE(l.mode() == 0x00);
+	}
+}
+
+TEST_CASE("Link restarts the handshake on timeouts and garbage, and "
+		  "reconnects", "[Link] [Lifecycle]") {
+	constexpr uint32_t tick_period { 10 };
+	const uint8_t burst[1] { static_cast<uint8_t>(Magics::SYS::ACK) };
+	const uint8_t ack { static_cast<uint8_t>(Magics::SYS::ACK) };
+	const uint8_t nack { static_cast<uint8_t>(Magics::SYS::NACK) };
+
+	Link l { burst, sizeof(burst), 57600 };
+	LinkReturn rtn { };
+	uint32_t now { 0 };
+
+	// Run ticks until an event other than LinkEvent::NONE is raised, or
+	// until the deadline passes
+	auto run_until_event = [&l, &now](uint32_t deadline) {
+		LinkEvent ev { LinkEvent::NONE };
+		while ((ev == LinkEvent::NONE) && (now < deadline)) {
+			now += tick_period;
+			ev = l.tick(now);
+		}
+		return ev;
+	};
+
+	SECTION("Handshake is restarted if not acknowledged in time") {
+		l.handshake_sent();
+		l.tick(now);
+		REQUIRE(run_until_event(now + 2 * DEFAULT_LINK_TIMEOUTS.handshake)
+				== LinkEvent::RESTART_HANDSHAKE);
+		REQUIRE(now >= DEFAULT_LINK_TIMEOUTS.handshake);
+		REQUIRE(now <= DEFAULT_LINK_TIMEOUTS.handshake + tick_period);
+		REQUIRE(l.state() == LinkState::HANDSHAKE);
+	}
+
+	SECTION("Unplugged links stall, restart, and reconnect when plugged "
+			"back in") {
+		for (uint32_t cycle = 0; cycle < 3; cycle++) {
+			const uint32_t plugged_in { now };
+			l.handshake_sent();
+			l.tick(now);
+			now += tick_period;
+			l.update(&ack, 1, rtn);
+			REQUIRE(rtn.event == LinkEvent::SWITCH_SPEED);
+			REQUIRE(l.state() == LinkState::DATA);
+			// Time back to data mode is bounded by the tick period
+			REQUIRE((now - plugged_in) <= tick_period);
+			l.tick(now);
+
+			// EV3 keeps the link alive
+			for (uint32_t i = 0; i < 10; i++) {
+				now += 100;
+				l.update(&nack, 1, rtn);
+				REQUIRE(rtn.event == LinkEvent::SEND_DATA);
+				REQUIRE(l.tick(now) == LinkEvent::NONE);
+			}
+
+			// EV3 unplugged
+			const uint32_t unplugged { now };
+			REQUIRE(run_until_event(now + DEFAULT_LINK_TIMEOUTS.disconnect)
+					== LinkEvent::STALLED);
+			REQUIRE(l.state() == LinkState::STALLED);
+			REQUIRE(run_until_event(now + DEFAULT_LINK_TIMEOUTS.disconnect)
+					== LinkEvent::RESTART_HANDSHAKE);
+			REQUIRE((now - unplugged) <= (DEFAULT_LINK_TIMEOUTS.disconnect
+										  + tick_period));
+			REQUIRE(l.state() == LinkState::HANDSHAKE);
+		}
+	}
+
+	SECTION("Stalled links resume when data is received") {
+		l.handshake_sent();
+		l.tick(now);
+		l.update(&ack, 1, rtn);
+		REQUIRE(run_until_event(now + DEFAULT_LINK_TIMEOUTS.disconnect)
+				== LinkEvent::STALLED);
+		l.update(&nack, 1, rtn);
+		REQUIRE(l.state() == LinkState::DATA);
+		REQUIRE(rtn.event == LinkEvent::SEND_DATA);
+	}
+
+	SECTION("Links carrying only garbage drop the speed") {
+		const std::vector<uint8_t> garbage(DEFAULT_LINK_POLICY.min_observed,
+			static_cast<uint8_t>(Magics::DATA::DATA_BASE));
+		// Connect, and feed the link garbage at its data speed
+		auto connect_to_garbage = [&]() {
+			l.handshake_sent();
+			l.tick(now);
+			l.update(&ack, 1, rtn);
+			size_t offset { 0 };
+			while (offset < garbage.size())
+				offset += l.update(garbage.data() + offset,
+								   garbage.size() - offset, rtn);
+			now += tick_period;
+			return l.tick(now);
+		};
+
+		REQUIRE(connect_to_garbage() == LinkEvent::DROP_SPEED);
+		REQUIRE(l.state() == LinkState::HANDSHAKE);
+		REQUIRE(l.data_speed() == 38400);
+
+		std::array<uint8_t, 1> lowered {
+			{ static_cast<uint8_t>(Magics::SYS::ACK) }
+		};
+		l.set_handshake(lowered.data(), lowered.size());
+		REQUIRE(l.handshake() == lowered.data());
+		REQUIRE(connect_to_garbage() == LinkEvent::DROP_SPEED);
+		REQUIRE(l.data_speed() == 19200);
+
+		// Healthy lines keep the lowered speed
+		l.handshake_sent();
+		l.tick(now);
+		l.update(&ack, 1, rtn);
+		REQUIRE(rtn.event == LinkEvent::SWITCH_SPEED);
+		for (uint32_t i = 0; i < DEFAULT_LINK_POLICY.min_observed; i++) {
+			l.update(&nack, 1, rtn);
+			now += 1;
+			REQUIRE(l.tick(now) == LinkEvent::NONE);
+		}
+		REQUIRE(l.data_speed() == 19200);
+
+		// Every standard speed below is tried in turn, and the handshake is
+		// restarted once the speed cannot be lowered
+		for (const uint32_t speed : { 9600, 4800, 2400 }) {
+			REQUIRE(connect_to_garbage() == LinkEvent::DROP_SPEED);
+			REQUIRE(l.data_speed() == speed);
+		}
+		REQUIRE(connect_to_garbage() == LinkEvent::RESTART_HANDSHAKE);
+		REQUIRE(l.data_speed() == 2400);
+	}
+}
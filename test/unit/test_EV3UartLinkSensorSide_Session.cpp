@@ -0,0 +1,231 @@
+/**
+ * \file test_EV3UartLinkSensorSide_Session.cpp
+ *
+ * Closed-loop tests for the sensor-side link, run against an emulated EV3
+ *
+ * The tests in this file verify that, for many links running concurrently,
+ * each fed by an emulated EV3 in blocks of random size:
+ * - The handshake completes
+ * - Every CMD SELECT, CMD WRITE and SYS NACK message sent by the EV3 is
+ *   parsed, in order
+ * - Every SYS NACK message is answered with a DATA message for the mode
+ *   last selected, with a valid FCS, including modes 8 - 15 selected and
+ *   answered with CMD EXT_MODE messages
+ *
+ * \copyright Shenghao Yang, 2018
+ * 
+ * See LICENSE for details
+ */
+
+#include <EV3UartLinkSensorSide.hpp>
+#include <EV3UartDataCacheSensorSide.hpp>
+#include <EV3UartProtocolParserHostSide.hpp>
+#include <EV3UartGenerator.hpp>
+#include "catch.hpp"
+#include <array>
+#include <deque>
+#include <memory>
+#include <random>
+#include <vector>
+
+using namespace EV3UartGenerator;
+using namespace EV3UartProtocolParserSensorSide;
+
+namespace {
+
+/**
+ * Emulated EV3, generating the messages an EV3 sends to a sensor and
+ * checking the sensor's replies
+ */
+class EmulatedHost {
+private:
+	std::mt19937& rng;
+	uint8_t selected_mode = 0;
+public:
+	std::deque<uint8_t> to_sensor { };	///< Bytes in flight to the sensor
+	/**
+	 * Messages the sensor must parse, with the mode selected by the EV3
+	 * when each message was sent
+	 */
+	std::deque<std::pair<ParseResult, uint8_t>> expected { };
+	uint32_t data_received = 0;			///< DATA messages received
+
+	explicit EmulatedHost(std::mt19937& r) : rng { r } { }
+
+	/**
+	 * Receive the sensor's handshake burst, and acknowledge it
+	 */
+	void receive_handshake(const uint8_t* burst, size_t len) {
+		REQUIRE(len > 0);
+		REQUIRE(burst[len - 1] == static_cast<uint8_t>(Magics::SYS::ACK));
+		send_frame([](uint8_t* b) {
+			return Framing::frame_sys_message(b, Magics::SYS::ACK); },
+			ParseResult::RECEIVED_SYS_ACK);
+	}
+
+	/**
+	 * Send one random message to the sensor
+	 */
+	void send_random_message() {
+		switch (rng() % 3) {
+		case 0:
+			selected_mode = (rng() % DATA_CACHE_MODES);
+			if (selected_mode >= 8) {
+				send_frame([](uint8_t* b) {
+					b[0] = (static_cast<uint8_t>(Magics::CMD::CMD_BASE)
+							| CMD_EXT_MODE);
+					b[1] = 0x08;
+					b[2] = Framing::checksum(b, 2);
+					return 3; },
+					ParseResult::RECEIVED_CMD_EXT_MODE);
+			}
+			send_frame([this](uint8_t* b) {
+				return Framing::frame_cmd_select_message(b,
+						selected_mode & 0x07); },
+				ParseResult::RECEIVED_CMD_SELECT);
+			break;
+		case 1:
+			{
+				std::array<uint8_t, 0x20> payload { };
+				const uint8_t len = (rng() % payload.size()) + 1;
+				for (uint8_t i = 0; i < len; i++)
+					payload[i] = rng();
+				send_frame([&payload, len](uint8_t* b) {
+					return Framing::frame_cmd_write_message(b,
+							payload.data(), len); },
+					ParseResult::RECEIVED_CMD_WRITE);
+			}
+			break;
+		default:
+			send_frame([](uint8_t* b) {
+				return Framing::frame_sys_message(b, Magics::SYS::NACK); },
+				ParseResult::RECEIVED_SYS_NACK);
+			break;
+		}
+	}
+
+	/**
+	 * Receive a DATA message from the sensor, and check it against the
+	 * mode that was selected when the SYS NACK message was sent
+	 */
+	void receive_data(const uint8_t* frame, uint8_t len, uint8_t mode) {
+		REQUIRE(frame != nullptr);
+		REQUIRE(len >= 3);
+
+		HostParser p { };
+		HostParserReturn rtn { };
+		size_t consumed { p.update(frame, len, rtn) };
+		if (mode >= 8) {
+			// CMD EXT_MODE message, then the DATA message
+			REQUIRE(consumed == EXT_MODE_PREFIX_LEN);
+			REQUIRE(rtn.res == HostParseResult::RECEIVED_CMD_EXT_MODE);
+			consumed += p.update(frame + consumed, len - consumed, rtn);
+		}
+		REQUIRE(consumed == len);
+		REQUIRE(rtn.res == HostParseResult::RECEIVED_DATA);
+		REQUIRE(p.mode() == mode);
+		data_received++;
+	}
+
+private:
+	template <typename F>
+	void send_frame(F framer, ParseResult result) {
+		std::array<uint8_t, Framing::BUFFER_MIN> buffer;
+		const uint8_t len = framer(buffer.data());
+		to_sensor.insert(to_sensor.end(), buffer.begin(), buffer.begin() + len);
+		expected.emplace_back(result, selected_mode);
+	}
+};
+
+/**
+ * Emulated sensor, built on the link and the DATA message cache
+ */
+struct EmulatedSensor {
+	Link link;
+	DataCache cache { };
+
+	EmulatedSensor(const uint8_t* burst, size_t len)
+		: link { burst, len, 115200 } {
+		for (uint8_t mode = 0; mode < DATA_CACHE_MODES; mode++) {
+			const uint8_t reading[2] { mode, static_cast<uint8_t>(~mode) };
+			cache.set(mode, reading, sizeof(reading));
+		}
+	}
+};
+}
+
+TEST_CASE("Links complete sessions with emulated EV3s", "[Link] [Session]") {
+	constexpr size_t link_count { 16 };
+	constexpr uint32_t messages_per_link { 500 };
+	std::mt19937 rng { 0x3e3 };
+
+	std::array<uint8_t, Framing::BUFFER_MIN * 2> burst { };
+	uint8_t burst_length { 0 };
+	burst_length += Framing::frame_cmd_speed_message(burst.data(), 115200);
+	burst_length += Framing::frame_sys_message(burst.data() + burst_length,
+											   Magics::SYS::ACK);
+
+	std::vector<EmulatedHost> hosts { };
+	std::vector<std::unique_ptr<EmulatedSensor>> sensors { };
+	for (size_t i = 0; i < link_count; i++) {
+		hosts.emplace_back(rng);
+		sensors.emplace_back(new EmulatedSensor { burst.data(), burst_length });
+		hosts[i].receive_handshake(sensors[i]->link.handshake(),
+								   sensors[i]->link.handshake_length());
+		sensors[i]->link.handshake_sent();
+		for (uint32_t m = 0; m < messages_per_link; m++)
+			hosts[i].send_random_message();
+	}
+
+	bool busy { true };
+	while (busy) {
+		busy = false;
+		// Interleave links, delivering blocks of random size to each
+		for (size_t i = 0; i < link_count; i++) {
+			EmulatedHost& host { hosts[i] };
+			EmulatedSensor& sensor { *sensors[i] };
+			if (host.to_sensor.empty())
+				continue;
+			busy = true;
+
+			std::vector<uint8_t> block(host.to_sensor.begin(),
+				host.to_sensor.begin()
+				+ std::min<size_t>(host.to_sensor.size(), (rng() % 40) + 1));
+			host.to_sensor.erase(host.to_sensor.begin(),
+								 host.to_sensor.begin() + block.size());
+
+			size_t offset { 0 };
+			while (offset < block.size()) {
+				LinkReturn rtn { };
+				offset += sensor.link.update(block.data() + offset,
+											 block.size() - offset, rtn);
+				if (rtn.msg.res == ParseResult::INSUFFICIENT_DATA)
+					continue;
+
+				REQUIRE(!host.expected.empty());
+				const auto expected = host.expected.front();
+				host.expected.pop_front();
+				REQUIRE(rtn.msg.res == expected.first);
+
+				switch (rtn.event) {
+				case LinkEvent::SWITCH_SPEED:
+					REQUIRE(sensor.link.state() == LinkState::DATA);
+					break;
+				case LinkEvent::SEND_DATA:
+					host.receive_data(
+						sensor.cache.frame(sensor.link.mode()),
+						sensor.cache.frame_length(sensor.link.mode()),
+						expected.second);
+					break;
+				default:
+					break;
+				}
+			}
+		}
+	}
+
+	for (const EmulatedHost& host : hosts) {
+		REQUIRE(host.expected.empty());
+		REQUIRE(host.data_received > 0);
+	}
+}
@@ -0,0 +1,164 @@
+/**
+ * \file test_EV3UartMessagePoolSensorSide.cpp
+ *
+ * Unit tests for functionality contained in EV3UartMessagePoolSensorSide.cpp
+ *
+ * The tests in this file verify that the pool:
+ * - Delivers messages only to subscribers whose filters accept them,
+ *   including messages with invalid FCS
+ * - Shares a single copy of each message between its subscribers
+ * - Keeps retained messages until they are released
+ * - Counts messages dropped because no slot was free
+ *
+ * \copyright Shenghao Yang, 2018
+ * 
+ * See LICENSE for details
+ */
+
+#include <EV3UartMessagePoolSensorSide.hpp>
+#include <EV3UartGenerator.hpp>
+#include "catch.hpp"
+#include <array>
+#include <cstring>
+#include <vector>
+
+using namespace EV3UartGenerator;
+using namespace EV3UartProtocolParserSensorSide;
+
+namespace {
+
+/**
+ * Subscriber recording the messages delivered to it
+ */
+struct Recorder {
+	std::vector<MessageHandle> handles { };
+	std::vector<const Message*> messages { };
+	std::vector<Message> copies { };	///< Messages, as delivered
+	bool retain = false;
+
+	static void deliver(void* context, MessagePool& pool,
+						MessageHandle handle) {
+		Recorder& r { *static_cast<Recorder*>(context) };
+		r.handles.push_back(handle);
+		r.messages.push_back(&pool.message(handle));
+		r.copies.push_back(pool.message(handle));
+		if (r.retain)
+			pool.retain(handle);
+	}
+};
+
+/**
+ * Parse a frame, and publish the message parsed
+ */
+bool parse_and_publish(MessagePool& pool, uint8_t port, const uint8_t* frame,
+					   uint8_t frame_size) {
+	Parser p { };
+	ParserReturn rtn { };
+	for (uint8_t i = 0; i < frame_size; i++)
+		rtn = p.update(frame[i]);
+	return pool.publish(port, rtn, p.data());
+}
+}
+
+TEST_CASE("MessagePool delivers messages to subscribers by filter",
+		  "[MessagePool]") {
+	MessagePool pool { };
+	Recorder all { }, writes { }, port_one { };
+	REQUIRE(pool.subscribe({ 0xffffffff, 0xffff }, Recorder::deliver, &all));
+	REQUIRE(pool.subscribe({ 0xffffffff,
+		result_mask(ParseResult::RECEIVED_CMD_WRITE) },
+		Recorder::deliver, &writes));
+	REQUIRE(pool.subscribe({ 0x02,
+		static_cast<uint16_t>(result_mask(ParseResult::RECEIVED_CMD_WRITE)
+		| result_mask(ParseResult::RECEIVED_CMD_SELECT)) },
+		Recorder::deliver, &port_one));
+
+	std::array<uint8_t, Framing::BUFFER_MIN> write { };
+	const uint8_t write_size { Framing::frame_cmd_write_message(write.data(),
+		reinterpret_cast<const uint8_t*>("Goodbye"), std::strlen("Goodbye")) };
+	std::array<uint8_t, Framing::BUFFER_MIN> select { };
+	const uint8_t select_size {
+		Framing::frame_cmd_select_message(select.data(), 0x05)
+	};
+
+	REQUIRE(parse_and_publish(pool, 0, write.data(), write_size));
+	REQUIRE(parse_and_publish(pool, 1, write.data(), write_size));
+	REQUIRE(parse_and_publish(pool, 1, select.data(), select_size));
+	REQUIRE(parse_and_publish(pool, 2, select.data(), select_size));
+
+	REQUIRE(all.messages.size() == 4);
+	REQUIRE(writes.messages.size() == 2);
+	REQUIRE(port_one.messages.size() == 2);
+
+	// Subscribers of the same message share the same copy
+	REQUIRE(writes.messages[1] == port_one.messages[0]);
+	REQUIRE(port_one.copies[0].port == 1);
+	REQUIRE(port_one.copies[0].info.res == ParseResult::RECEIVED_CMD_WRITE);
+	REQUIRE(std::memcmp(port_one.copies[0].payload, "Goodbye", 7) == 0);
+	REQUIRE(port_one.copies[1].info.res == ParseResult::RECEIVED_CMD_SELECT);
+	REQUIRE(port_one.copies[1].payload[0] == 0x05);
+
+	// Nothing was retained, every slot is free again
+	REQUIRE(pool.available() == MESSAGE_POOL_SLOTS);
+
+	SECTION("Out of range ports are rejected") {
+		REQUIRE(!parse_and_publish(pool, MESSAGE_POOL_PORTS, select.data(),
+								   select_size));
+	}
+
+	SECTION("Messages with invalid FCS can be subscribed to") {
+		Recorder damaged { };
+		REQUIRE(pool.subscribe({ 0xffffffff,
+			result_mask(ParseResult::RECEIVED_CMD_INVALID_FCS) },
+			Recorder::deliver, &damaged));
+		write[write_size - 1] ^= 0x01;
+		REQUIRE(parse_and_publish(pool, 3, write.data(), write_size));
+		REQUIRE(parse_and_publish(pool, 3, select.data(), select_size));
+		REQUIRE(damaged.copies.size() == 1);
+		REQUIRE(damaged.copies[0].info.res
+				== ParseResult::RECEIVED_CMD_INVALID_FCS);
+		REQUIRE(damaged.copies[0].port == 3);
+		REQUIRE(all.messages.size() == 6);
+		REQUIRE(writes.messages.size() == 2);
+	}
+
+	SECTION("Subscribers beyond the maximum are rejected") {
+		Recorder extra { };
+		for (uint8_t i = 3; i < MESSAGE_POOL_SUBSCRIBERS; i++)
+			REQUIRE(pool.subscribe({ 0, 0 }, Recorder::deliver, &extra));
+		REQUIRE(!pool.subscribe({ 0, 0 }, Recorder::deliver, &extra));
+	}
+}
+
+TEST_CASE("MessagePool keeps retained messages until released",
+		  "[MessagePool]") {
+	MessagePool pool { };
+	Recorder keeper { };
+	keeper.retain = true;
+	REQUIRE(pool.subscribe({ 0xffffffff, 0xffff }, Recorder::deliver,
+						   &keeper));
+
+	std::array<uint8_t, Framing::BUFFER_MIN> select { };
+	for (uint8_t i = 0; i < MESSAGE_POOL_SLOTS; i++) {
+		const uint8_t select_size {
+			Framing::frame_cmd_select_message(select.data(), i % 8)
+		};
+		REQUIRE(parse_and_publish(pool, 0, select.data(), select_size));
+	}
+	REQUIRE(pool.available() == 0);
+
+	// Retained messages are intact
+	for (uint8_t i = 0; i < MESSAGE_POOL_SLOTS; i++)
+		REQUIRE(pool.message(keeper.handles[i]).payload[0] == (i % 8));
+
+	// Pool is exhausted, further messages are dropped
+	const uint8_t select_size {
+		Framing::frame_cmd_select_message(select.data(), 0)
+	};
+	REQUIRE(!parse_and_publish(pool, 0, select.data(), select_size));
+	REQUIRE(pool.dropped() == 1);
+
+	pool.release(keeper.handles[0]);
+	REQUIRE(pool.available() == 1);
+	REQUIRE(parse_and_publish(pool, 0, select.data(), select_size));
+}
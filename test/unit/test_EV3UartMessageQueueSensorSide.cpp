@@ -0,0 +1,181 @@
+/**
+ * \file test_EV3UartMessageQueueSensorSide.cpp
+ *
+ * Unit tests for functionality contained in EV3UartMessageQueueSensorSide.cpp
+ *
+ * The tests in this file verify that the queue:
+ * - Delivers messages in order, copying them out
+ * - Applies each overflow policy when full, and counts what it did not
+ *   deliver
+ * - Keeps the order of delivery when replacing messages
+ *
+ * \copyright Shenghao Yang, 2018
+ * 
+ * See LICENSE for details
+ */
+
+#include <EV3UartMessageQueueSensorSide.hpp>
+#include <EV3UartGenerator.hpp>
+#include "catch.hpp"
+#include <vector>
+
+using namespace EV3UartGenerator;
+using namespace EV3UartProtocolParserSensorSide;
+
+namespace {
+
+/**
+ * Push a CMD SELECT message for \c mode from \c port
+ */
+bool push_select(MessageQueue& q, uint8_t port, uint8_t mode) {
+	const ParserReturn rtn {
+		ParseResult::RECEIVED_CMD_SELECT,
+		(static_cast<uint8_t>(Magics::CMD::CMD_BASE)
+		 | static_cast<uint8_t>(Magics::CMD::SELECT)), 0x01
+	};
+	return q.push(port, rtn, &mode);
+}
+
+/**
+ * Push a CMD WRITE message with a one byte payload from \c port
+ */
+bool push_write(MessageQueue& q, uint8_t port, uint8_t value) {
+	const ParserReturn rtn {
+		ParseResult::RECEIVED_CMD_WRITE,
+		(static_cast<uint8_t>(Magics::CMD::CMD_BASE)
+		 | static_cast<uint8_t>(Magics::CMD::WRITE)), 0x01
+	};
+	return q.push(port, rtn, &value);
+}
+
+/**
+ * Push a SYS NACK message from \c port
+ */
+bool push_nack(MessageQueue& q, uint8_t port) {
+	const ParserReturn rtn {
+		ParseResult::RECEIVED_SYS_NACK,
+		static_cast<uint8_t>(Magics::SYS::NACK), 0x00
+	};
+	const uint8_t payload { 0x00 };
+	return q.push(port, rtn, &payload);
+}
+
+/**
+ * Drain the queue, returning the modes of the CMD SELECT messages in it
+ */
+std::vector<uint8_t> drain_modes(MessageQueue& q) {
+	std::vector<uint8_t> modes { };
+	Message m { };
+	while (q.pop(m)) {
+		if (m.info.res == ParseResult::RECEIVED_CMD_SELECT)
+			modes.push_back(m.payload[0]);
+	}
+	return modes;
+}
+
+/**
+ * Drain the queue, returning the results of the messages in it
+ */
+std::vector<ParseResult> drain_results(MessageQueue& q) {
+	std::vector<ParseResult> results { };
+	Message m { };
+	while (q.pop(m))
+		results.push_back(m.info.res);
+	return results;
+}
+}
+
+TEST_CASE("MessageQueue delivers messages in order", "[MessageQueue]") {
+	MessageQueue q { OverflowPolicy::REJECT };
+	Message m { };
+	REQUIRE(q.empty());
+	REQUIRE(!q.pop(m));
+
+	// Wrap around the queue a few times
+	for (uint8_t round = 0; round < 3; round++) {
+		for (uint8_t i = 0; i < 10; i++)
+			REQUIRE(push_select(q, 0, i));
+		REQUIRE(q.size() == 10);
+		std::vector<uint8_t> expected(10);
+		for (uint8_t i = 0; i < 10; i++)
+			expected[i] = i;
+		REQUIRE(drain_modes(q) == expected);
+	}
+	REQUIRE(!q.pop(m));
+	REQUIRE(q.empty());
+
+	SECTION("Copies stay valid after the queue is reused") {
+		REQUIRE(push_select(q, 3, 0x05));
+		REQUIRE(q.pop(m));
+		for (uint8_t i = 0; i < MESSAGE_QUEUE_LEN; i++)
+			REQUIRE(push_select(q, 0, 0xaa));
+		REQUIRE(m.port == 3);
+		REQUIRE(m.info.res == ParseResult::RECEIVED_CMD_SELECT);
+		REQUIRE(m.info.len == 1);
+		REQUIRE(m.payload[0] == 0x05);
+	}
+}
+
+TEST_CASE("MessageQueue applies overflow policies when full",
+		  "[MessageQueue]") {
+	SECTION("REJECT rejects new messages") {
+		MessageQueue q { OverflowPolicy::REJECT };
+		for (uint8_t i = 0; i < MESSAGE_QUEUE_LEN; i++)
+			REQUIRE(push_select(q, 0, i));
+		REQUIRE(!push_select(q, 0, 0xff));
+		REQUIRE(q.statistics().rejected == 1);
+		REQUIRE(drain_modes(q).front() == 0);
+	}
+
+	SECTION("DROP_OLDEST drops the oldest messages") {
+		MessageQueue q { OverflowPolicy::DROP_OLDEST };
+		for (uint8_t i = 0; i < MESSAGE_QUEUE_LEN + 3; i++)
+			REQUIRE(push_select(q, 0, i));
+		REQUIRE(q.size() == MESSAGE_QUEUE_LEN);
+		REQUIRE(q.statistics().dropped_oldest == 3);
+		const std::vector<uint8_t> modes { drain_modes(q) };
+		REQUIRE(modes.front() == 3);
+		REQUIRE(modes.back() == (MESSAGE_QUEUE_LEN + 2));
+	}
+
+	SECTION("KEEP_LATEST replaces the newest message of the same type") {
+		MessageQueue q { OverflowPolicy::KEEP_LATEST };
+		REQUIRE(push_select(q, 1, 0));
+		for (uint8_t i = 1; i < MESSAGE_QUEUE_LEN; i++)
+			REQUIRE(push_nack(q, 0));
+
+		// Replaces the SELECT from port 1
+		REQUIRE(push_select(q, 1, 7));
+		REQUIRE(q.statistics().replaced == 1);
+		// No SELECT from port 2 queued, rejected
+		REQUIRE(!push_select(q, 2, 5));
+		REQUIRE(q.statistics().rejected == 1);
+		// Replaces a NACK
+		REQUIRE(push_nack(q, 0));
+		REQUIRE(q.statistics().replaced == 2);
+
+		REQUIRE(q.size() == MESSAGE_QUEUE_LEN);
+		REQUIRE(drain_modes(q) == std::vector<uint8_t> { 7 });
+	}
+
+	SECTION("KEEP_LATEST delivers replacements after older messages") {
+		MessageQueue q { OverflowPolicy::KEEP_LATEST };
+		REQUIRE(push_select(q, 1, 0));
+		REQUIRE(push_write(q, 1, 0x42));
+		for (uint8_t i = 2; i < MESSAGE_QUEUE_LEN; i++)
+			REQUIRE(push_nack(q, 0));
+
+		// The newer SELECT must not overtake the WRITE queued before it
+		REQUIRE(push_select(q, 1, 7));
+		REQUIRE(q.statistics().replaced == 1);
+		REQUIRE(q.size() == MESSAGE_QUEUE_LEN);
+
+		std::vector<ParseResult> expected {
+			ParseResult::RECEIVED_CMD_WRITE
+		};
+		expected.insert(expected.end(), MESSAGE_QUEUE_LEN - 2,
+						ParseResult::RECEIVED_SYS_NACK);
+		expected.push_back(ParseResult::RECEIVED_CMD_SELECT);
+		REQUIRE(drain_results(q) == expected);
+	}
+}
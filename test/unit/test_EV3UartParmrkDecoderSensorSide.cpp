@@ -0,0 +1,138 @@
+/**
+ * \file test_EV3UartParmrkDecoderSensorSide.cpp
+ *
+ * Unit tests for functionality contained in EV3UartParmrkDecoderSensorSide.cpp
+ *
+ * The tests in this file verify that the decoder:
+ * - Passes data bytes through without copying them
+ * - Decodes escaped data bytes, breaks and bytes with errors, even when
+ *   escape sequences are split across blocks
+ * - Lets the parser abandon messages corrupted by a line event, and parse
+ *   the messages following it
+ *
+ * \copyright Shenghao Yang, 2018
+ * 
+ * See LICENSE for details
+ */
+
+#include <EV3UartParmrkDecoderSensorSide.hpp>
+#include <EV3UartGenerator.hpp>
+#include "catch.hpp"
+#include <array>
+#include <cstring>
+#include <vector>
+
+using namespace EV3UartGenerator;
+using namespace EV3UartProtocolParserSensorSide;
+
+namespace {
+
+/**
+ * Element of a decoded stream: a data byte, or a line event
+ */
+struct Decoded {
+	bool is_event;
+	uint8_t byte;
+	LineEvent event;
+
+	bool operator==(const Decoded& other) const {
+		return (is_event == other.is_event)
+			&& (is_event ? (event == other.event) : (byte == other.byte));
+	}
+};
+
+/**
+ * Decode a stream, split into blocks of \c chunk bytes
+ */
+std::vector<Decoded> decode(const std::vector<uint8_t>& stream, size_t chunk) {
+	ParmrkDecoder d { };
+	std::vector<Decoded> decoded { };
+	for (size_t offset = 0; offset < stream.size(); offset += chunk) {
+		const uint8_t* block { stream.data() + offset };
+		size_t len { std::min(chunk, stream.size() - offset) };
+		while (len) {
+			LineInput in { };
+			const size_t consumed { d.decode(block, len, in) };
+			REQUIRE(consumed > 0);
+			// Data bytes must point into the block, not be copied
+			if (in.len) {
+				REQUIRE(in.data >= block);
+				REQUIRE((in.data + in.len) <= (block + consumed));
+			}
+			for (size_t i = 0; i < in.len; i++)
+				decoded.push_back(Decoded { false, in.data[i], LineEvent::BREAK });
+			if (in.event_valid)
+				decoded.push_back(Decoded { true, 0x00, in.event });
+			block += consumed;
+			len -= consumed;
+		}
+	}
+	return decoded;
+}
+}
+
+TEST_CASE("ParmrkDecoder decodes marked input", "[ParmrkDecoder]") {
+	const std::vector<uint8_t> stream {
+		0x01, 0x02,
+		0xff, 0xff,				// Escaped 0xff
+		0x03,
+		0xff, 0x00, 0x00,		// Break
+		0xff, 0x00, 0x55,		// Byte with error
+		0xff, 0xff, 0xff, 0xff,	// Two escaped 0xff
+		0x04,
+	};
+	const std::vector<Decoded> expected {
+		{ false, 0x01, LineEvent::BREAK },
+		{ false, 0x02, LineEvent::BREAK },
+		{ false, 0xff, LineEvent::BREAK },
+		{ false, 0x03, LineEvent::BREAK },
+		{ true, 0x00, LineEvent::BREAK },
+		{ true, 0x00, LineEvent::BYTE_ERROR },
+		{ false, 0xff, LineEvent::BREAK },
+		{ false, 0xff, LineEvent::BREAK },
+		{ false, 0x04, LineEvent::BREAK },
+	};
+
+	for (size_t chunk = 1; chunk <= stream.size(); chunk++)
+		REQUIRE(decode(stream, chunk) == expected);
+}
+
+TEST_CASE("Parser abandons messages corrupted by line events decoded by "
+		  "ParmrkDecoder", "[ParmrkDecoder] [Parser] [line_event]") {
+	std::array<uint8_t, Framing::BUFFER_MIN> select { };
+	const uint8_t select_size {
+		Framing::frame_cmd_select_message(select.data(), 0x02)
+	};
+
+	// CMD WRITE header, one byte with an error, then a good CMD SELECT
+	std::vector<uint8_t> stream {
+		(static_cast<uint8_t>(Magics::CMD::CMD_BASE)
+		 | static_cast<uint8_t>(Magics::CMD::WRITE) | (0x05 << 0x03)),
+		0x10, 0xff, 0x00, 0x20
+	};
+	stream.insert(stream.end(), select.begin(), select.begin() + select_size);
+
+	ParmrkDecoder d { };
+	Parser p { };
+	std::vector<ParseResult> results { };
+	uint32_t abandoned { 0 };
+	const uint8_t* block { stream.data() };
+	size_t len { stream.size() };
+	while (len) {
+		LineInput in { };
+		const size_t consumed { d.decode(block, len, in) };
+		block += consumed;
+		len -= consumed;
+		for (size_t i = 0; i < in.len; i++) {
+			const ParserReturn rtn { p.update(in.data[i]) };
+			if (rtn.res != ParseResult::INSUFFICIENT_DATA)
+				results.push_back(rtn.res);
+		}
+		if (in.event_valid && p.line_event(in.event))
+			abandoned++;
+	}
+
+	REQUIRE(abandoned == 1);
+	REQUIRE(results == std::vector<ParseResult> {
+		ParseResult::RECEIVED_CMD_SELECT });
+}
@@ -0,0 +1,247 @@
+/**
+ * \file test_EV3UartProtocolParserHostSide.cpp
+ *
+ * Unit tests for functionality contained in EV3UartProtocolParserHostSide.cpp
+ *
+ * The tests in this file verify that the host-side parser:
+ * - Classifies every header byte the way the protocol defines them
+ * - Parses SYS, CMD, INFO and DATA messages sent by sensors
+ * - Reports messages with invalid FCS
+ * - Applies CMD EXT_MODE offsets to the following DATA message
+ * - Produces the same results from blocks as from single bytes
+ *
+ * \copyright Shenghao Yang, 2018
+ *
+ * See LICENSE for details
+ */
+
+#include <EV3UartProtocolParserHostSide.hpp>
+#include <EV3UartGenerator.hpp>
+#include "catch.hpp"
+#include <vector>
+#include <algorithm>
+#include <cstring>
+
+using namespace EV3UartGenerator;
+using namespace EV3UartProtocolParserSensorSide;
+
+namespace {
+
+/**
+ * Frame a message from its header byte and the bytes between the header and
+ * FCS bytes
+ */
+std::vector<uint8_t> frame(uint8_t hdr, const std::vector<uint8_t>& body) {
+	std::vector<uint8_t> msg { hdr };
+	msg.insert(msg.end(), body.begin(), body.end());
+	msg.push_back(Framing::checksum(msg.data(), msg.size()));
+	return msg;
+}
+
+/**
+ * Feed a message to the parser byte by byte, requiring that only the last
+ * byte produces a result
+ */
+HostParserReturn feed(HostParser& p, const std::vector<uint8_t>& msg) {
+	HostParserReturn rtn { };
+	for (size_t i = 0; i < msg.size(); i++) {
+		rtn = p.update(msg[i]);
+		if (i != (msg.size() - 1))
+			REQUIRE(rtn.res == HostParseResult::INSUFFICIENT_DATA);
+	}
+	return rtn;
+}
+
+constexpr uint8_t CMD_TYPE_HDR {
+	static_cast<uint8_t>(Magics::CMD::CMD_BASE)
+	| static_cast<uint8_t>(Magics::CMD::TYPE)
+};
+constexpr uint8_t INFO_HDR { static_cast<uint8_t>(Magics::INFO::INFO_BASE) };
+constexpr uint8_t DATA_HDR { static_cast<uint8_t>(Magics::DATA::DATA_BASE) };
+}
+
+TEST_CASE("HostParser classifies header bytes", "[HostParser]") {
+	const std::vector<uint8_t> valid_headers {
+		0x00, 0x04,							// SYS SYNC, ACK
+		0x40, 0x41, 0x49, 0x51, 0x52, 0x46,	// CMD TYPE, MODES, SPEED, EXT_MODE
+	};
+
+	for (uint16_t hdr = 0; hdr < 0x100; hdr++) {
+		HostParser p { };
+		const HostParserReturn rtn { p.update(static_cast<uint8_t>(hdr)) };
+		const bool info_or_data { (hdr >= INFO_HDR)
+								  && (((hdr >> 3) & 0x07) < 6) };
+		const bool listed { std::find(valid_headers.begin(),
+									  valid_headers.end(), hdr)
+							!= valid_headers.end() };
+		CAPTURE(hdr);
+		REQUIRE((rtn.res != HostParseResult::RECEIVED_INVALID_HEADER)
+				== (info_or_data || listed));
+	}
+}
+
+TEST_CASE("HostParser parses messages from the sensor", "[HostParser]") {
+	HostParser p { };
+
+	SECTION("SYS messages") {
+		REQUIRE(p.update(static_cast<uint8_t>(Magics::SYS::SYNC)).res
+				== HostParseResult::RECEIVED_SYS_SYNC);
+		REQUIRE(p.update(static_cast<uint8_t>(Magics::SYS::ACK)).res
+				== HostParseResult::RECEIVED_SYS_ACK);
+	}
+
+	SECTION("CMD TYPE and CMD MODES messages") {
+		HostParserReturn rtn { feed(p, frame(CMD_TYPE_HDR, { 29 })) };
+		REQUIRE(rtn.res == HostParseResult::RECEIVED_CMD_TYPE);
+		REQUIRE(rtn.len == 1);
+		REQUIRE(p.data()[0] == 29);
+
+		rtn = feed(p, frame(0x49, { 0x05, 0x03 }));
+		REQUIRE(rtn.res == HostParseResult::RECEIVED_CMD_MODES);
+		REQUIRE(rtn.len == 2);
+		REQUIRE(p.data()[1] == 0x03);
+	}
+
+	SECTION("CMD SPEED messages") {
+		uint8_t msg[Framing::BUFFER_MIN];
+		const int8_t len { Framing::frame_cmd_speed_message(msg, 57600) };
+		const HostParserReturn rtn {
+			feed(p, std::vector<uint8_t>(msg, msg + len))
+		};
+		REQUIRE(rtn.res == HostParseResult::RECEIVED_CMD_SPEED);
+		REQUIRE(p.speed() == 57600);
+	}
+
+	SECTION("INFO messages") {
+		const std::vector<uint8_t> name { 'C', 'O', 'L', '-', 'R', 'E', 'F',
+										  'L' };
+		std::vector<uint8_t> body { 0x00 };
+		body.insert(body.end(), name.begin(), name.end());
+
+		HostParserReturn rtn { feed(p, frame(INFO_HDR | (3 << 3) | 5, body)) };
+		REQUIRE(rtn.res == HostParseResult::RECEIVED_INFO);
+		REQUIRE(rtn.len == name.size());
+		REQUIRE(p.info_type() == 0x00);
+		REQUIRE(p.mode() == 5);
+		REQUIRE(std::memcmp(p.data(), name.data(), name.size()) == 0);
+
+		body[0] = INFO_MODE_PLUS_8;
+		rtn = feed(p, frame(INFO_HDR | (3 << 3) | 5, body));
+		REQUIRE(rtn.res == HostParseResult::RECEIVED_INFO);
+		REQUIRE(p.mode() == 13);
+	}
+
+	SECTION("Bytes needed to complete INFO messages") {
+		const std::vector<uint8_t> msg {
+			frame(INFO_HDR | (5 << 3), std::vector<uint8_t>(33, 0x20))
+		};
+		REQUIRE(p.bytes_needed() == 1);
+		p.update(msg[0]);
+		// Info type byte, payload and FCS
+		REQUIRE(p.bytes_needed() == 34);
+		HostParserReturn rtn { };
+		REQUIRE(p.update(msg.data() + 1, 34, rtn) == 34);
+		REQUIRE(rtn.res == HostParseResult::RECEIVED_INFO);
+		REQUIRE(p.bytes_needed() == 1);
+	}
+
+	SECTION("DATA messages of every length") {
+		for (uint8_t code = 0; code < 6; code++) {
+			std::vector<uint8_t> payload(two_pow(code));
+			for (size_t i = 0; i < payload.size(); i++)
+				payload[i] = static_cast<uint8_t>(i * 7);
+
+			const HostParserReturn rtn {
+				feed(p, frame(DATA_HDR | (code << 3) | 2, payload))
+			};
+			REQUIRE(rtn.res == HostParseResult::RECEIVED_DATA);
+			REQUIRE(rtn.len == payload.size());
+			REQUIRE(p.mode() == 2);
+			REQUIRE(std::memcmp(p.data(), payload.data(), payload.size())
+					== 0);
+		}
+	}
+
+	SECTION("Messages with invalid FCS") {
+		std::vector<uint8_t> msg { frame(DATA_HDR | (1 << 3), { 1, 2 }) };
+		msg.back() ^= 0x01;
+		const HostParserReturn rtn { feed(p, msg) };
+		REQUIRE(rtn.res == HostParseResult::RECEIVED_INVALID_FCS);
+		REQUIRE(rtn.len == 2);
+		REQUIRE(p.update(static_cast<uint8_t>(Magics::SYS::ACK)).res
+				== HostParseResult::RECEIVED_SYS_ACK);
+	}
+}
+
+TEST_CASE("HostParser applies CMD EXT_MODE offsets to the next DATA message",
+		  "[HostParser]") {
+	HostParser p { };
+	const std::vector<uint8_t> ext_mode {
+		frame(static_cast<uint8_t>(Magics::CMD::CMD_BASE) | CMD_EXT_MODE,
+			  { 0x08 })
+	};
+	const std::vector<uint8_t> data { frame(DATA_HDR | 1, { 0x55 }) };
+
+	REQUIRE(feed(p, ext_mode).res == HostParseResult::RECEIVED_CMD_EXT_MODE);
+	REQUIRE(feed(p, data).res == HostParseResult::RECEIVED_DATA);
+	REQUIRE(p.mode() == 9);
+	REQUIRE(feed(p, data).res == HostParseResult::RECEIVED_DATA);
+	REQUIRE(p.mode() == 1);
+
+	SECTION("Any other message cancels the offset") {
+		feed(p, ext_mode);
+		p.update(static_cast<uint8_t>(Magics::SYS::ACK));
+		feed(p, data);
+		REQUIRE(p.mode() == 1);
+	}
+
+	SECTION("Resetting the parser cancels the offset") {
+		feed(p, ext_mode);
+		REQUIRE_FALSE(p.line_event(LineEvent::BREAK));
+		feed(p, data);
+		REQUIRE(p.mode() == 1);
+	}
+}
+
+TEST_CASE("HostParser produces the same results from blocks",
+		  "[HostParser]") {
+	std::vector<uint8_t> stream { };
+	for (uint8_t i = 0; i < 64; i++) {
+		const std::vector<uint8_t> msg {
+			frame(DATA_HDR | ((i % 6) << 3) | (i % 8),
+				  std::vector<uint8_t>(two_pow(i % 6), i))
+		};
+		stream.insert(stream.end(), msg.begin(), msg.end());
+		if (i % 5 == 0)
+			stream.push_back(0xff); // Invalid header byte
+	}
+
+	HostParser bytewise { };
+	std::vector<HostParseResult> expected { };
+	for (const uint8_t b : stream) {
+		const HostParserReturn rtn { bytewise.update(b) };
+		if (rtn.res != HostParseResult::INSUFFICIENT_DATA)
+			expected.push_back(rtn.res);
+	}
+
+	for (size_t block_len = 1; block_len < 40; block_len += 3) {
+		HostParser blockwise { };
+		std::vector<HostParseResult> results { };
+		size_t offset { 0 };
+		while (offset < stream.size()) {
+			size_t len { std::min(block_len, stream.size() - offset) };
+			while (len) {
+				HostParserReturn rtn { };
+				const size_t consumed {
+					blockwise.update(stream.data() + offset, len, rtn)
+				};
+				offset += consumed;
+				len -= consumed;
+				if (rtn.res != HostParseResult::INSUFFICIENT_DATA)
+					results.push_back(rtn.res);
+			}
+		}
+		CAPTURE(block_len);
+		REQUIRE(results == expected);
+	}
+}
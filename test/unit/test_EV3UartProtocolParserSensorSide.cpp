@@ -7,10 +7,16 @@
  * - The main utility functions in the source file work as intended.
  * - The parser defined in the source file:
  * 	 - Is able to parse single bytes correctly
+ * 	 - Reports every CMD message with good FCS as its own command
  * 	 - Is able to parse CMD_WRITE messages correctly
  * 	 - Is able to parse CMD_SELECT messages correctly
+ * 	 - Is able to parse CMD_SPEED messages correctly
+ * 	 - Applies CMD_EXT_MODE offsets to the following CMD_SELECT and CMD_WRITE
+ * 	   messages
  * 	 - Is ready to parse a new message after parsing any type of message
  * 	 - Resets when Parser::reset_state() is called
+ * 	 - Abandons partially parsed messages when Parser::line_event() is called
+ * 	 - Reports the number of bytes needed to complete the message being parsed
  * 	 - Provides the right memory area when Parser::data() is called
  *
  * \copyright Shenghao Yang, 2018
@@ -88,7 +94,12 @@ TEST_CASE("Parser returns correct values for single header bytes and"
 		(static_cast<uint8_t>(Magics::SYS::SYS_BASE)
 		 | static_cast<uint8_t>(Magics::SYS::NACK)),
 		(static_cast<uint8_t>(Magics::CMD::CMD_BASE)
-		 | static_cast<uint8_t>(Magics::CMD::SELECT))
+		 | static_cast<uint8_t>(Magics::CMD::SELECT)),
+		// CMD_SPEED carries a fixed 4 byte payload, length code 2
+		(static_cast<uint8_t>(Magics::CMD::CMD_BASE)
+		 | static_cast<uint8_t>(Magics::CMD::SPEED)
+		 | (0x02 << 0x03)),
+		(static_cast<uint8_t>(Magics::CMD::CMD_BASE) | CMD_EXT_MODE)
 	};
 	// Add CMD_WRITE header bytes with all possible valid length codes
 	// to set of valid header bytes.
@@ -120,7 +131,8 @@ TEST_CASE("Parser returns correct values for single header bytes and"
 				REQUIRE(rtn.res == ParseResult::RECEIVED_SYS_NACK);
 				REQUIRE(test_parser_ready_to_process_another_message(p));
 			} else {
-				// Header byte is a CMD_SELECT byte or CMD_WRITE byte
+				// Header byte is a CMD_SELECT, CMD_WRITE, CMD_SPEED or
+				// CMD_EXT_MODE byte
 				REQUIRE(rtn.res == ParseResult::INSUFFICIENT_DATA);
 			}
 		}
@@ -129,6 +141,44 @@ TEST_CASE("Parser returns correct values for single header bytes and"
 	}
 }
 
+TEST_CASE("Parser reports every CMD message with good FCS as its own "
+		  "command", "[Parser] [Header]") {
+	for (uint16_t hdr = static_cast<uint8_t>(Magics::CMD::CMD_BASE);
+		 hdr < static_cast<uint8_t>(Magics::INFO::INFO_BASE); hdr++) {
+		Parser p { };
+		if (p.update(static_cast<uint8_t>(hdr)).res
+			!= ParseResult::INSUFFICIENT_DATA)
+			continue; // Not a CMD header accepted by the parser
+
+		// Header, zeroed payload and FCS
+		std::vector<uint8_t> msg(two_pow((hdr >> 0x03) & 0x07) + 0x01, 0x00);
+		msg.front() = static_cast<uint8_t>(hdr);
+		msg.push_back(Framing::checksum(msg.data(), msg.size()));
+		ParserReturn rtn { };
+		REQUIRE(p.update(msg.data() + 1, msg.size() - 1, rtn)
+				== (msg.size() - 1));
+
+		CAPTURE(hdr);
+		switch (hdr & 0x07) {
+		case static_cast<uint8_t>(Magics::CMD::SELECT):
+			REQUIRE(rtn.res == ParseResult::RECEIVED_CMD_SELECT);
+			break;
+		case static_cast<uint8_t>(Magics::CMD::WRITE):
+			REQUIRE(rtn.res == ParseResult::RECEIVED_CMD_WRITE);
+			break;
+		case static_cast<uint8_t>(Magics::CMD::SPEED):
+			REQUIRE(rtn.res == ParseResult::RECEIVED_CMD_SPEED);
+			break;
+		case CMD_EXT_MODE:
+			REQUIRE(rtn.res == ParseResult::RECEIVED_CMD_EXT_MODE);
+			break;
+		default:
+			FAIL("Parser accepted a CMD header without a result");
+			break;
+		}
+	}
+}
+
 TEST_CASE("Parser returns correct results for CMD_SELECT messages and "
 		  "is ready to parse new messages after parsing a CMD_SELECT "
 		  "message", "[Parser]"
@@ -277,6 +327,146 @@ TEST_CASE("Parser returns correct results for CMD_WRITE messages and"
 	}
 }
 
+TEST_CASE("Parser returns correct results for CMD_SPEED messages and "
+		  "is ready to parse new messages after parsing a CMD_SPEED "
+		  "message", "[Parser]"
+		  " [CMD_SPEED]") {
+	const std::array<uint32_t, 5> speeds {
+		2400, 57600, 115200, 460800, 0x12345678
+	};
+	SECTION("Parser returns correct results for valid CMD_SPEED messages") {
+		for (const uint32_t speed : speeds) {
+			std::array<uint8_t, Framing::BUFFER_MIN> buffer;
+			const int8_t frame_size { Framing::frame_cmd_speed_message(
+					buffer.data(), speed) };
+
+			Parser p { };
+			for (uint8_t i = 0; i < frame_size; i++) {
+				ParserReturn rtn = p.update(buffer[i]);
+				if ((i + 1) != frame_size) {
+					// We have not reached the end of frame, we expect
+					// INSUFFICIENT_DATA
+					REQUIRE(rtn.res == ParseResult::INSUFFICIENT_DATA);
+				} else {
+					// End of frame parsed, we expect recognition of this
+					REQUIRE(rtn.res == ParseResult::RECEIVED_CMD_SPEED);
+					// Length must match payload length
+					REQUIRE(rtn.len == 0x04);
+					// Decoded baud rate must match sent baud rate
+					REQUIRE(p.speed() == speed);
+					// Must be ready to parse new message
+					REQUIRE(test_parser_ready_to_process_another_message(p));
+				}
+				// In all situations, we expect the header to be valid
+				REQUIRE(rtn.hdr == buffer[0]);
+			}
+		}
+	}
+	SECTION("Parser returns correct results for invalid CMD_SPEED messages"
+			" with invalid FCS") {
+		for (const uint32_t speed : speeds) {
+			std::array<uint8_t, Framing::BUFFER_MIN> buffer;
+			const int8_t frame_size { Framing::frame_cmd_speed_message(
+					buffer.data(), speed) };
+
+			// Purposely damage FCS
+			buffer[frame_size - 1] = (buffer[frame_size - 1] + 0x01);
+
+			Parser p { };
+			for (uint8_t i = 0; i < frame_size; i++) {
+				ParserReturn rtn = p.update(buffer[i]);
+				if ((i + 1) == frame_size) {
+					REQUIRE(rtn.res == ParseResult::RECEIVED_CMD_INVALID_FCS);
+					REQUIRE(rtn.len == 0x04);
+					REQUIRE(test_parser_ready_to_process_another_message(p));
+				} else {
+					REQUIRE(rtn.res == ParseResult::INSUFFICIENT_DATA);
+				}
+			}
+		}
+	}
+}
+
+/**
+ * Frames a CMD_EXT_MODE message
+ *
+ * @param target buffer to write the message to
+ * @param offset mode offset carried by the message
+ * @return size of the frame, in bytes
+ */
+static uint8_t frame_cmd_ext_mode_message(uint8_t* target, uint8_t offset) {
+	target[0] = (static_cast<uint8_t>(Magics::CMD::CMD_BASE) | CMD_EXT_MODE);
+	target[1] = offset;
+	target[2] = Framing::checksum(target, 2);
+	return 3;
+}
+
+TEST_CASE("Parser applies CMD_EXT_MODE offsets to the next CMD_SELECT or "
+		  "CMD_WRITE message", "[Parser] [CMD_EXT_MODE]") {
+	std::array<uint8_t, Framing::BUFFER_MIN> buffer;
+	Parser p { };
+
+	auto parse = [&p](const uint8_t* frame, uint8_t frame_size) {
+		ParserReturn rtn { };
+		for (uint8_t i = 0; i < frame_size; i++)
+			rtn = p.update(frame[i]);
+		return rtn;
+	};
+
+	SECTION("CMD_EXT_MODE messages are recognized") {
+		const uint8_t frame_size {
+			frame_cmd_ext_mode_message(buffer.data(), 0x08)
+		};
+		ParserReturn rtn { parse(buffer.data(), frame_size) };
+		REQUIRE(rtn.res == ParseResult::RECEIVED_CMD_EXT_MODE);
+		REQUIRE(rtn.len == 0x01);
+		REQUIRE(test_parser_ready_to_process_another_message(p));
+	}
+
+	SECTION("Modes 8 - 15 are reachable through CMD_SELECT") {
+		for (uint8_t mode = 0; mode < 0x08; mode++) {
+			parse(buffer.data(), frame_cmd_ext_mode_message(buffer.data(), 0x08));
+			ParserReturn rtn { parse(buffer.data(),
+				Framing::frame_cmd_select_message(buffer.data(), mode)) };
+			REQUIRE(rtn.res == ParseResult::RECEIVED_CMD_SELECT);
+			REQUIRE(p.mode_offset() == 0x08);
+			REQUIRE(p.selected_mode() == (mode + 0x08));
+
+			// Offset only applies to the message directly following it
+			rtn = parse(buffer.data(),
+				Framing::frame_cmd_select_message(buffer.data(), mode));
+			REQUIRE(rtn.res == ParseResult::RECEIVED_CMD_SELECT);
+			REQUIRE(p.selected_mode() == mode);
+		}
+	}
+
+	SECTION("Offsets apply to CMD_WRITE messages") {
+		parse(buffer.data(), frame_cmd_ext_mode_message(buffer.data(), 0x08));
+		ParserReturn rtn { parse(buffer.data(),
+			Framing::frame_cmd_write_message(buffer.data(),
+				reinterpret_cast<const uint8_t*>("Hi"), 2)) };
+		REQUIRE(rtn.res == ParseResult::RECEIVED_CMD_WRITE);
+		REQUIRE(p.mode_offset() == 0x08);
+	}
+
+	SECTION("Other messages cancel the offset") {
+		parse(buffer.data(), frame_cmd_ext_mode_message(buffer.data(), 0x08));
+		parse(buffer.data(),
+			  Framing::frame_sys_message(buffer.data(), Magics::SYS::NACK));
+		parse(buffer.data(),
+			  Framing::frame_cmd_select_message(buffer.data(), 0x01));
+		REQUIRE(p.selected_mode() == 0x01);
+	}
+
+	SECTION("Parser::reset_state() cancels the offset") {
+		parse(buffer.data(), frame_cmd_ext_mode_message(buffer.data(), 0x08));
+		p.reset_state();
+		parse(buffer.data(),
+			  Framing::frame_cmd_select_message(buffer.data(), 0x01));
+		REQUIRE(p.selected_mode() == 0x01);
+	}
+}
+
 TEST_CASE("Parser::reset_state() correctly resets the state of the parser",
 		  "[Parser] [reset_state]") {
 	// The only time when the parser needs to have its state reset is when
@@ -301,3 +491,100 @@ TEST_CASE("Parser::reset_state() correctly resets the state of the parser",
 	// header byte, which means that the parser has indeed reset
 	REQUIRE(test_parser_ready_to_process_another_message(p));
 }
+
+TEST_CASE("Parser::line_event() abandons partially parsed messages",
+		  "[Parser] [line_event]") {
+	std::array<uint8_t, Framing::BUFFER_MIN> message;
+	const uint8_t message_size {
+		Framing::frame_cmd_write_message(message.data(),
+		reinterpret_cast<const uint8_t*>("Hello world!"),
+		std::strlen("Hello world!"))
+	};
+
+	for (const LineEvent ev : { LineEvent::BREAK, LineEvent::BYTE_ERROR,
+								LineEvent::TIMEOUT }) {
+		Parser p { };
+		// No message pending, nothing to abandon
+		REQUIRE(!p.line_event(ev));
+		std::for_each(message.begin(), message.begin() + (message_size / 2),
+				[&p](const uint8_t b) { p.update(b); });
+		REQUIRE(p.line_event(ev));
+		REQUIRE(test_parser_ready_to_process_another_message(p));
+
+		// Message sent after the event is parsed
+		ParserReturn rtn { };
+		std::for_each(message.begin(), message.begin() + message_size,
+				[&p, &rtn](const uint8_t b) { rtn = p.update(b); });
+		REQUIRE(rtn.res == ParseResult::RECEIVED_CMD_WRITE);
+	}
+}
+
+TEST_CASE("Parser::bytes_needed() reports the bytes left in the message",
+		  "[Parser] [bytes_needed]") {
+	SECTION("Parser::bytes_needed() counts down to the FCS byte") {
+		for (uint8_t payload_length = 1; payload_length <= 0x20;
+				payload_length++) {
+			std::array<uint8_t, 0x20> payload;
+			std::iota(payload.begin(), payload.end(), 0x00);
+			std::array<uint8_t, Framing::BUFFER_MIN> buffer;
+			const int8_t frame_size { Framing::frame_cmd_write_message(
+					buffer.data(), payload.data(), payload_length) };
+
+			Parser p { };
+			REQUIRE(p.bytes_needed() == 1);
+			for (uint8_t i = 0; i < frame_size; i++) {
+				p.update(buffer[i]);
+				// Back to waiting for a header byte after the FCS byte
+				REQUIRE(p.bytes_needed()
+						== ((i + 1 == frame_size) ? 1 : (frame_size - i - 1)));
+			}
+		}
+	}
+
+	SECTION("Reads of Parser::bytes_needed() bytes each produce a result") {
+		std::vector<uint8_t> stream { };
+		std::array<uint8_t, Framing::BUFFER_MIN> buffer;
+		size_t cmd_messages { 0 };
+		std::array<uint8_t, 0x20> payload;
+		for (uint8_t i = 0; i < 0x20; i++) {
+			payload.fill(i);
+			int8_t frame_size { };
+			switch (i % 3) {
+			case 0:
+				frame_size = Framing::frame_cmd_select_message(buffer.data(),
+															   i % 8);
+				break;
+			case 1:
+				frame_size = Framing::frame_sys_message(buffer.data(),
+														Magics::SYS::NACK);
+				break;
+			default:
+				frame_size = Framing::frame_cmd_write_message(buffer.data(),
+						payload.data(), (i % 0x20) + 1);
+				break;
+			}
+			stream.insert(stream.end(), buffer.begin(),
+						  buffer.begin() + frame_size);
+			if (frame_size > 1)
+				cmd_messages += 1;
+		}
+
+		Parser p { };
+		size_t offset { 0 };
+		size_t reads { 0 };
+		size_t results { 0 };
+		while (offset < stream.size()) {
+			const size_t len { p.bytes_needed() };
+			ParserReturn rtn { };
+			REQUIRE(p.update(stream.data() + offset, len, rtn) == len);
+			offset += len;
+			reads += 1;
+			if (rtn.res != ParseResult::INSUFFICIENT_DATA)
+				results += 1;
+		}
+		// A CMD message takes one read for its header byte, and one for the
+		// rest of it
+		REQUIRE(results == 0x20);
+		REQUIRE(reads == (results + cmd_messages));
+	}
+}
@@ -8,6 +8,12 @@
  * - The parser defined in the source file is able to:
  *   - Parse multiple messages, one after another.
  *   - Parse messages prepended with invalid bytes.
+ *   - Parse blocks of bytes, split at arbitrary boundaries, with the same
+ *     results as parsing them byte-by-byte.
+ *   - Collapse superseded CMD SELECT and duplicate SYS ACK messages within
+ *     a block, without reordering them relative to other messages.
+ *   - Collapse CMD SELECT messages preceded by CMD EXT_MODE messages, with
+ *     the same results as collapsing the byte-by-byte results.
  *
  * \copyright Shenghao Yang, 2018
  * 
@@ -24,6 +30,7 @@
 #include <cstring>
 #include <array>
 #include <tuple>
+#include <random>
 
 using namespace EV3UartProtocolParserSensorSide;
 using namespace EV3UartGenerator;
@@ -108,3 +115,226 @@ TEST_CASE("Parser is able to parse messages prepended with invalid bytes",
 		}
 }
 
+
+TEST_CASE("Parser returns the same results for blocks of bytes as for "
+		  "single bytes", "[Parser] [Bulk]") {
+	std::array<uint8_t, Framing::BUFFER_MIN * 6 + (6 * 5)> message { };
+	decltype(message)::iterator write_target { message.begin() };
+
+	write_target += Framing::frame_cmd_write_message(write_target,
+			reinterpret_cast<const uint8_t*>("Goodbye"),
+			std::strlen("Goodbye"));
+	write_target = add_invalid_bytes(write_target, 5);
+	write_target += Framing::frame_sys_message(write_target, Magics::SYS::ACK);
+	write_target += Framing::frame_cmd_select_message(write_target, 0x02);
+	write_target = add_invalid_bytes(write_target, 5);
+	write_target += Framing::frame_cmd_write_message(write_target,
+			reinterpret_cast<const uint8_t*>("Hello world!"),
+			std::strlen("Hello world!"));
+	write_target += Framing::frame_sys_message(write_target, Magics::SYS::NACK);
+
+	const size_t message_size = write_target - message.begin();
+
+	// Reference results, obtained byte-by-byte
+	std::vector<std::tuple<ParseResult, uint8_t, std::vector<uint8_t>>>
+		expected { };
+	Parser ref { };
+	for (size_t i = 0; i < message_size; i++) {
+		ParserReturn rtn { ref.update(message[i]) };
+		if (rtn.res != ParseResult::INSUFFICIENT_DATA)
+			expected.emplace_back(rtn.res, rtn.hdr,
+				std::vector<uint8_t>(ref.data(), ref.data() + rtn.len));
+	}
+
+	for (size_t chunk = 1; chunk <= message_size; chunk++) {
+		Parser p { };
+		std::vector<std::tuple<ParseResult, uint8_t, std::vector<uint8_t>>>
+			results { };
+		for (size_t offset = 0; offset < message_size; offset += chunk) {
+			const uint8_t* block { message.data() + offset };
+			size_t len { std::min(chunk, message_size - offset) };
+			while (len) {
+				ParserReturn rtn { };
+				const size_t consumed { p.update(block, len, rtn) };
+				REQUIRE(consumed > 0);
+				REQUIRE(consumed <= len);
+				block += consumed;
+				len -= consumed;
+				if (rtn.res != ParseResult::INSUFFICIENT_DATA)
+					results.emplace_back(rtn.res, rtn.hdr,
+						std::vector<uint8_t>(p.data(), p.data() + rtn.len));
+			}
+		}
+		REQUIRE(results == expected);
+	}
+
+	SECTION("Parser consumes no bytes from an empty block") {
+		Parser p { };
+		ParserReturn rtn { };
+		REQUIRE(p.update(message.data(), 0, rtn) == 0);
+		REQUIRE(rtn.res == ParseResult::INSUFFICIENT_DATA);
+	}
+}
+
+TEST_CASE("Parser collapses superseded CMD_SELECT and duplicate SYS_ACK "
+		  "messages within a block", "[Parser] [Bulk] [Coalesce]") {
+	std::array<uint8_t, Framing::BUFFER_MIN * 10> message { };
+	decltype(message)::iterator write_target { message.begin() };
+
+	write_target += Framing::frame_cmd_select_message(write_target, 0x00);
+	write_target += Framing::frame_cmd_select_message(write_target, 0x01);
+	write_target += Framing::frame_cmd_select_message(write_target, 0x02);
+	write_target += Framing::frame_cmd_write_message(write_target,
+			reinterpret_cast<const uint8_t*>("Goodbye"),
+			std::strlen("Goodbye"));
+	write_target += Framing::frame_cmd_select_message(write_target, 0x03);
+	write_target += Framing::frame_sys_message(write_target, Magics::SYS::ACK);
+	write_target += Framing::frame_sys_message(write_target, Magics::SYS::ACK);
+	write_target += Framing::frame_sys_message(write_target, Magics::SYS::ACK);
+	write_target += Framing::frame_sys_message(write_target, Magics::SYS::NACK);
+	// SELECT with damaged FCS must not supersede the preceding one
+	write_target += Framing::frame_cmd_select_message(write_target, 0x04);
+	write_target += Framing::frame_cmd_select_message(write_target, 0x05);
+	*(write_target - 1) += 0x01;
+
+	const std::array<std::pair<ParseResult, uint8_t>, 7> expected_results { {
+		{ ParseResult::RECEIVED_CMD_SELECT, 0x02 },
+		{ ParseResult::RECEIVED_CMD_WRITE, 'G' },
+		{ ParseResult::RECEIVED_CMD_SELECT, 0x03 },
+		{ ParseResult::RECEIVED_SYS_ACK, 0x00 },
+		{ ParseResult::RECEIVED_SYS_NACK, 0x00 },
+		{ ParseResult::RECEIVED_CMD_SELECT, 0x04 },
+		{ ParseResult::RECEIVED_CMD_INVALID_FCS, 0x05 },
+	} };
+
+	Parser p { };
+	CoalesceStatistics stats { };
+	const uint8_t* block { message.data() };
+	size_t len = write_target - message.begin();
+	uint32_t message_count = 0;
+	while (len) {
+		ParserReturn rtn { };
+		const size_t consumed { p.update_coalesced(block, len, rtn, stats) };
+		block += consumed;
+		len -= consumed;
+		if (rtn.res == ParseResult::INSUFFICIENT_DATA)
+			continue;
+		REQUIRE(message_count < expected_results.size());
+		REQUIRE(rtn.res == expected_results[message_count].first);
+		if (rtn.len)
+			REQUIRE(*(p.data()) == expected_results[message_count].second);
+		message_count++;
+	}
+
+	REQUIRE(message_count == expected_results.size());
+	REQUIRE(stats.select_collapsed == 2);
+	REQUIRE(stats.ack_collapsed == 2);
+}
+
+TEST_CASE("Parser collapses CMD SELECT messages preceded by CMD EXT_MODE "
+		  "messages within a block", "[Parser] [Bulk] [Coalesce]") {
+	// Result, effective mode or first payload byte, mode offset
+	using Result = std::tuple<ParseResult, uint8_t, uint8_t>;
+	const auto result = [](const Parser& p, const ParserReturn& rtn) {
+		if (rtn.res == ParseResult::RECEIVED_CMD_SELECT)
+			return Result { rtn.res, p.selected_mode(), p.mode_offset() };
+		return Result { rtn.res, rtn.len ? *(p.data()) : 0x00, 0x00 };
+	};
+
+	// Bursts of CMD SELECT messages, each preceded by a CMD EXT_MODE
+	// message as sent by hosts selecting modes 8 - 15, separated by
+	// other messages
+	std::mt19937 rng { 0x28 };
+	std::vector<uint8_t> stream { };
+	uint8_t frame[Framing::BUFFER_MIN];
+	for (uint16_t i = 0; i < 2000; i++) {
+		const uint8_t mode { static_cast<uint8_t>(rng() % 16) };
+		switch (rng() % 8) {
+		case 0:
+			stream.insert(stream.end(), frame,
+				frame + Framing::frame_cmd_write_message(frame,
+						reinterpret_cast<const uint8_t*>("Goodbye"),
+						std::strlen("Goodbye")));
+			break;
+		case 1:
+			stream.insert(stream.end(), frame,
+				frame + Framing::frame_sys_message(frame, Magics::SYS::ACK));
+			break;
+		case 2:
+			// SELECT without EXT_MODE, possibly with damaged FCS
+			stream.insert(stream.end(), frame,
+				frame + Framing::frame_cmd_select_message(frame, mode & 0x07));
+			if (!(rng() % 4))
+				stream.back() += 0x01;
+			break;
+		default:
+			{
+				std::vector<uint8_t> ext_mode {
+					static_cast<uint8_t>(
+						static_cast<uint8_t>(Magics::CMD::CMD_BASE)
+						| CMD_EXT_MODE),
+					static_cast<uint8_t>(mode & 0x08)
+				};
+				ext_mode.push_back(Framing::checksum(ext_mode.data(),
+													 ext_mode.size()));
+				stream.insert(stream.end(), ext_mode.begin(), ext_mode.end());
+				stream.insert(stream.end(), frame,
+					frame + Framing::frame_cmd_select_message(frame,
+															  mode & 0x07));
+			}
+			break;
+		}
+	}
+
+	// Collapse the byte-by-byte results: a CMD SELECT message supersedes
+	// the CMD SELECT message, and the CMD EXT_MODE message, before it
+	Parser bytewise { };
+	std::vector<Result> expected { };
+	uint32_t select_collapsed { 0 };
+	uint32_t ack_collapsed { 0 };
+	for (const uint8_t b : stream) {
+		const ParserReturn rtn { bytewise.update(b) };
+		if (rtn.res == ParseResult::INSUFFICIENT_DATA)
+			continue;
+		const Result r { result(bytewise, rtn) };
+		const size_t n { expected.size() };
+		if ((rtn.res == ParseResult::RECEIVED_CMD_SELECT) && (n >= 1)
+			&& (std::get<0>(expected[n - 1])
+				== ParseResult::RECEIVED_CMD_SELECT)) {
+			expected.pop_back();
+			select_collapsed += 1;
+		} else if ((rtn.res == ParseResult::RECEIVED_CMD_SELECT) && (n >= 2)
+				   && (std::get<0>(expected[n - 1])
+					   == ParseResult::RECEIVED_CMD_EXT_MODE)
+				   && (std::get<0>(expected[n - 2])
+					   == ParseResult::RECEIVED_CMD_SELECT)) {
+			expected.resize(n - 2);
+			select_collapsed += 1;
+		} else if ((rtn.res == ParseResult::RECEIVED_SYS_ACK) && (n >= 1)
+				   && (std::get<0>(expected[n - 1])
+					   == ParseResult::RECEIVED_SYS_ACK)) {
+			ack_collapsed += 1;
+			continue;
+		}
+		expected.push_back(r);
+	}
+	REQUIRE(select_collapsed > 0);
+
+	Parser p { };
+	CoalesceStatistics stats { };
+	std::vector<Result> results { };
+	const uint8_t* block { stream.data() };
+	size_t len { stream.size() };
+	while (len) {
+		ParserReturn rtn { };
+		const size_t consumed { p.update_coalesced(block, len, rtn, stats) };
+		block += consumed;
+		len -= consumed;
+		if (rtn.res != ParseResult::INSUFFICIENT_DATA)
+			results.push_back(result(p, rtn));
+	}
+
+	REQUIRE(results == expected);
+	REQUIRE(stats.select_collapsed == select_collapsed);
+	REQUIRE(stats.ack_collapsed == ack_collapsed);
+}
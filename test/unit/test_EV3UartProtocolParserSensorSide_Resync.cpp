@@ -0,0 +1,326 @@
+/**
+ * \file test_EV3UartProtocolParserSensorSide_Resync.cpp
+ *
+ * Unit tests for the ResyncParser contained in
+ * EV3UartProtocolParserSensorSide.cpp
+ *
+ * The tests in this file verify that the ResyncParser:
+ * - Returns the same results as the Parser for streams without false
+ *   header bytes
+ * - Finds messages immediately following any false CMD header byte, which
+ *   the Parser loses
+ * - Reports messages containing embedded frames with good FCS as they
+ *   were sent, instead of the embedded frames
+ * - Reports messages with invalid FCS
+ * - Reports messages held back behind false header bytes when flushed,
+ *   without waiting for more bytes
+ * - Keeps the data() of messages at the end of its window accessible
+ * - Resets when ResyncParser::reset_state() is called
+ *
+ * \copyright Shenghao Yang, 2018
+ * 
+ * See LICENSE for details
+ */
+
+#include <EV3UartProtocolParserSensorSide.hpp>
+#include <EV3UartGenerator.hpp>
+#include "catch.hpp"
+#include <array>
+#include <cstring>
+#include <random>
+#include <vector>
+
+using namespace EV3UartGenerator;
+using namespace EV3UartProtocolParserSensorSide;
+
+namespace {
+
+/**
+ * Parse a stream, collecting the results of significance and the payload
+ * of the messages parsed
+ */
+template <typename P>
+std::vector<std::pair<ParseResult, std::vector<uint8_t>>> parse(
+		P& p, const uint8_t* stream, size_t len) {
+	std::vector<std::pair<ParseResult, std::vector<uint8_t>>> results { };
+	for (size_t i = 0; i < len; i++) {
+		const ParserReturn rtn { p.update(stream[i]) };
+		if (rtn.res != ParseResult::INSUFFICIENT_DATA)
+			results.emplace_back(rtn.res,
+				std::vector<uint8_t>(p.data(), p.data() + rtn.len));
+	}
+	return results;
+}
+
+/**
+ * Flush a ResyncParser, collecting the messages it held back
+ */
+void flush(ResyncParser& p,
+		   std::vector<std::pair<ParseResult, std::vector<uint8_t>>>& results) {
+	for (ParserReturn rtn { p.flush() };
+		 rtn.res != ParseResult::INSUFFICIENT_DATA; rtn = p.flush())
+		results.emplace_back(rtn.res,
+			std::vector<uint8_t>(p.data(), p.data() + rtn.len));
+}
+
+/**
+ * CMD WRITE header byte with a 32 byte payload
+ */
+constexpr uint8_t WRITE_32_HEADER {
+	static_cast<uint8_t>(Magics::CMD::CMD_BASE)
+	| static_cast<uint8_t>(Magics::CMD::WRITE) | (0x05 << 0x03)
+};
+}
+
+TEST_CASE("ResyncParser returns the same results as Parser for streams "
+		  "without false header bytes", "[ResyncParser]") {
+	std::array<uint8_t, Framing::BUFFER_MIN * 8> message { };
+	decltype(message)::iterator write_target { message.begin() };
+
+	write_target += Framing::frame_cmd_write_message(write_target,
+			reinterpret_cast<const uint8_t*>("Goodbye"),
+			std::strlen("Goodbye"));
+	*(write_target++) = static_cast<uint8_t>(Magics::DATA::DATA_BASE);
+	write_target += Framing::frame_sys_message(write_target, Magics::SYS::ACK);
+	write_target += Framing::frame_sys_message(write_target, Magics::SYS::NACK);
+	write_target += Framing::frame_cmd_select_message(write_target, 0x03);
+	write_target += Framing::frame_cmd_speed_message(write_target, 57600);
+	write_target += Framing::frame_cmd_select_message(write_target, 0x04);
+	*(write_target - 1) += 0x01; // Corrupt FCS
+	write_target += Framing::frame_cmd_write_message(write_target,
+			reinterpret_cast<const uint8_t*>("Hello world!"),
+			std::strlen("Hello world!"));
+
+	const size_t len = write_target - message.begin();
+	Parser reference { };
+	ResyncParser p { };
+	REQUIRE(parse(p, message.data(), len)
+			== parse(reference, message.data(), len));
+}
+
+TEST_CASE("ResyncParser finds messages following false CMD header bytes",
+		  "[ResyncParser]") {
+	for (uint16_t false_header = 0; false_header < 0x100; false_header++) {
+		std::array<uint8_t, Framing::BUFFER_MIN * 4> message { };
+		decltype(message)::iterator write_target { message.begin() };
+
+		*(write_target++) = false_header;
+		write_target += Framing::frame_cmd_select_message(write_target, 0x02);
+		write_target += Framing::frame_cmd_write_message(write_target,
+				reinterpret_cast<const uint8_t*>("Goodbye"),
+				std::strlen("Goodbye"));
+
+		// The line goes idle before any hypothesis started by the false
+		// header byte is resolved
+		ResyncParser p { };
+		auto results { parse(p, message.data(),
+							 write_target - message.begin()) };
+		flush(p, results);
+		uint32_t found { 0 };
+		for (const auto& result : results) {
+			switch (result.first) {
+			case ParseResult::RECEIVED_CMD_SELECT:
+				REQUIRE(result.second == std::vector<uint8_t> { 0x02 });
+				found |= 0x01;
+				break;
+			case ParseResult::RECEIVED_CMD_WRITE:
+				REQUIRE(std::memcmp(result.second.data(), "Goodbye", 7) == 0);
+				found |= 0x02;
+				break;
+			default:
+				break;
+			}
+		}
+		// All messages following the false header byte must be found
+		REQUIRE(found == 0x03);
+	}
+
+	SECTION("Parser loses messages following a false CMD header byte") {
+		std::array<uint8_t, Framing::BUFFER_MIN * 2> message { };
+		decltype(message)::iterator write_target { message.begin() };
+		*(write_target++) = WRITE_32_HEADER;
+		write_target += Framing::frame_cmd_select_message(write_target, 0x02);
+		for (uint8_t i = 0; i < Framing::BUFFER_MIN; i++)
+			write_target += Framing::frame_sys_message(write_target,
+													   Magics::SYS::NACK);
+
+		Parser reference { };
+		ResyncParser p { };
+		const size_t len = write_target - message.begin();
+		const auto results { parse(p, message.data(), len) };
+		REQUIRE(!results.empty());
+		REQUIRE(results[0].first == ParseResult::RECEIVED_CMD_SELECT);
+		for (const auto& result : parse(reference, message.data(), len))
+			REQUIRE(result.first != ParseResult::RECEIVED_CMD_SELECT);
+	}
+}
+
+TEST_CASE("ResyncParser reports messages containing embedded frames",
+		  "[ResyncParser]") {
+	// CMD WRITE message whose payload contains a complete CMD SELECT message
+	std::array<uint8_t, 0x08> payload { { 0x11, 0x43, 0x05, 0x00,
+										  0x22, 0x33, 0x44, 0x55 } };
+	payload[3] = Framing::checksum(payload.data() + 1, 2);
+	std::array<uint8_t, Framing::BUFFER_MIN * 2> message { };
+	const uint8_t message_size {
+		Framing::frame_cmd_write_message(message.data(), payload.data(),
+										 payload.size())
+	};
+
+	SECTION("Older messages with good FCS win over embedded frames") {
+		ResyncParser p { };
+		const auto results { parse(p, message.data(), message_size) };
+		REQUIRE(results.size() == 1);
+		REQUIRE(results[0].first == ParseResult::RECEIVED_CMD_WRITE);
+		REQUIRE(results[0].second == std::vector<uint8_t>(payload.begin(),
+														  payload.end()));
+
+		// The parser is ready for the next message
+		REQUIRE(p.update(static_cast<uint8_t>(Magics::SYS::NACK)).res
+				== ParseResult::RECEIVED_SYS_NACK);
+	}
+
+	SECTION("Embedded frames are reported once the message covering them "
+			"fails its FCS check") {
+		message[message_size - 1] += 0x01; // Corrupt FCS
+		ResyncParser p { };
+		const auto results { parse(p, message.data(), message_size) };
+		REQUIRE(results.size() == 1);
+		REQUIRE(results[0].first == ParseResult::RECEIVED_CMD_SELECT);
+		REQUIRE(results[0].second == std::vector<uint8_t> { 0x05 });
+	}
+
+	SECTION("Streams of messages with random payloads are reported as sent") {
+		std::mt19937 rng { 0x2d };
+		std::vector<uint8_t> stream { };
+		std::vector<std::pair<ParseResult, std::vector<uint8_t>>> expected { };
+		for (uint16_t i = 0; i < 20000; i++) {
+			std::array<uint8_t, 0x20> random_payload;
+			for (uint8_t& b : random_payload)
+				b = rng();
+			const uint8_t size {
+				Framing::frame_cmd_write_message(message.data(),
+					random_payload.data(), random_payload.size())
+			};
+			stream.insert(stream.end(), message.begin(),
+						  message.begin() + size);
+			expected.emplace_back(ParseResult::RECEIVED_CMD_WRITE,
+				std::vector<uint8_t>(random_payload.begin(),
+									 random_payload.end()));
+		}
+
+		ResyncParser p { };
+		REQUIRE(parse(p, stream.data(), stream.size()) == expected);
+	}
+}
+
+TEST_CASE("ResyncParser reports held back messages when flushed",
+		  "[ResyncParser] [flush]") {
+	std::array<uint8_t, Framing::BUFFER_MIN> message { };
+	message[0] = WRITE_32_HEADER;
+	const uint8_t message_size {
+		static_cast<uint8_t>(
+			Framing::frame_cmd_select_message(message.data() + 1, 0x06) + 1)
+	};
+
+	SECTION("Messages are held back while the line is idle") {
+		ResyncParser p { };
+		REQUIRE(parse(p, message.data(), message_size).empty());
+
+		const ParserReturn rtn { p.flush() };
+		REQUIRE(rtn.res == ParseResult::RECEIVED_CMD_SELECT);
+		REQUIRE(rtn.hdr == message[1]);
+		REQUIRE(p.data()[0] == 0x06);
+		REQUIRE(p.flush().res == ParseResult::INSUFFICIENT_DATA);
+
+		// The parser is ready for the next message
+		REQUIRE(p.update(static_cast<uint8_t>(Magics::SYS::NACK)).res
+				== ParseResult::RECEIVED_SYS_NACK);
+	}
+
+	SECTION("Line events abandon pending hypotheses") {
+		ResyncParser p { };
+		parse(p, message.data(), message_size);
+		REQUIRE(p.line_event(LineEvent::BREAK));
+		REQUIRE_FALSE(p.line_event(LineEvent::BREAK));
+
+		std::vector<std::pair<ParseResult, std::vector<uint8_t>>> results { };
+		flush(p, results);
+		REQUIRE(results.size() == 1);
+		REQUIRE(results[0].first == ParseResult::RECEIVED_CMD_SELECT);
+		REQUIRE(results[0].second == std::vector<uint8_t> { 0x06 });
+	}
+
+	SECTION("Every held back message is reported, oldest first") {
+		std::vector<uint8_t> stream { WRITE_32_HEADER };
+		for (uint8_t mode = 0; mode < 4; mode++) {
+			uint8_t select[Framing::BUFFER_MIN];
+			stream.insert(stream.end(), select,
+						  select + Framing::frame_cmd_select_message(select,
+																	 mode));
+		}
+
+		ResyncParser p { };
+		auto results { parse(p, stream.data(), stream.size()) };
+		REQUIRE(results.empty());
+		flush(p, results);
+		REQUIRE(results.size() == 4);
+		for (uint8_t mode = 0; mode < 4; mode++) {
+			REQUIRE(results[mode].first == ParseResult::RECEIVED_CMD_SELECT);
+			REQUIRE(results[mode].second == std::vector<uint8_t> { mode });
+		}
+	}
+
+	SECTION("Flushing an idle parser reports nothing") {
+		ResyncParser p { };
+		REQUIRE(p.flush().res == ParseResult::INSUFFICIENT_DATA);
+		REQUIRE_FALSE(p.line_event(LineEvent::TIMEOUT));
+	}
+}
+
+TEST_CASE("ResyncParser::data() of messages at the end of its window",
+		  "[ResyncParser] [data]") {
+	// CMD SELECT message ending at the FCS byte of a false CMD WRITE header
+	// byte, reported from the end of the window when the false header byte
+	// fails its FCS check
+	std::vector<uint8_t> stream { WRITE_32_HEADER };
+	stream.resize(0x20 - 0x01, 0xff);
+	std::array<uint8_t, Framing::BUFFER_MIN> message { };
+	const uint8_t message_size {
+		Framing::frame_cmd_select_message(message.data(), 0x07)
+	};
+	stream.insert(stream.end(), message.begin(),
+				  message.begin() + message_size);
+	REQUIRE(stream.size() == 0x22);
+	REQUIRE(Framing::checksum(stream.data(), 0x21) != stream.back());
+
+	ResyncParser p { };
+	ParserReturn rtn { };
+	for (const uint8_t b : stream)
+		rtn = p.update(b);
+	REQUIRE(rtn.res == ParseResult::RECEIVED_CMD_SELECT);
+	REQUIRE(p.data()[0] == 0x07);
+
+	// The memory area has the size Parser::data() guarantees
+	std::array<uint8_t, BUFFER_LEN - 1> copy { };
+	std::memcpy(copy.data(), p.data(), copy.size());
+	REQUIRE(copy[0] == 0x07);
+}
+
+TEST_CASE("ResyncParser::reset_state() discards pending hypotheses",
+		  "[ResyncParser] [reset_state]") {
+	std::array<uint8_t, Framing::BUFFER_MIN> message { };
+	const uint8_t message_size {
+		Framing::frame_cmd_write_message(message.data(),
+		reinterpret_cast<const uint8_t*>("Hello world!"),
+		std::strlen("Hello world!"))
+	};
+
+	ResyncParser p { };
+	parse(p, message.data(), message_size / 2);
+	p.reset_state();
+	// Invalid header byte must be reported as such
+	REQUIRE(p.update(static_cast<uint8_t>(Magics::CMD::CMD_BASE)
+					 | static_cast<uint8_t>(Magics::CMD::TYPE)).res
+			== ParseResult::RECEIVED_INVALID_HEADER);
+}
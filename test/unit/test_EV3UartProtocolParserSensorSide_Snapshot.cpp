@@ -0,0 +1,171 @@
+/**
+ * \file test_EV3UartProtocolParserSensorSide_Snapshot.cpp
+ *
+ * Unit tests for the snapshot and restore functionality contained in
+ * EV3UartProtocolParserSensorSide.cpp
+ *
+ * The tests in this file verify that:
+ * - A parser restored from a snapshot taken at any point within a message
+ *   parses the rest of the message with the same result
+ * - Snapshots of many parsers can be taken and restored in bulk
+ * - Truncated, inconsistent and other-version snapshots are rejected
+ *
+ * \copyright Shenghao Yang, 2018
+ * 
+ * See LICENSE for details
+ */
+
+#include <EV3UartProtocolParserSensorSide.hpp>
+#include <EV3UartGenerator.hpp>
+#include "catch.hpp"
+#include <array>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+using namespace EV3UartGenerator;
+using namespace EV3UartProtocolParserSensorSide;
+
+TEST_CASE("Parser restored from a snapshot continues parsing",
+		  "[Parser] [Snapshot]") {
+	std::array<uint8_t, Framing::BUFFER_MIN> message { };
+	const uint8_t message_size {
+		Framing::frame_cmd_write_message(message.data(),
+		reinterpret_cast<const uint8_t*>("Hello world, goodbye world!"),
+		std::strlen("Hello world, goodbye world!"))
+	};
+
+	for (uint8_t split = 0; split < message_size; split++) {
+		Parser p { };
+		for (uint8_t i = 0; i < split; i++)
+			p.update(message[i]);
+
+		std::array<uint8_t, SNAPSHOT_MAX_LEN> snapshot { };
+		const uint8_t snapshot_size { p.snapshot(snapshot.data()) };
+		REQUIRE(snapshot_size == (SNAPSHOT_HEADER_LEN + split));
+
+		Parser restored { };
+		REQUIRE(restored.restore(snapshot.data(), snapshot.size())
+				== snapshot_size);
+
+		ParserReturn rtn { };
+		for (uint8_t i = split; i < message_size; i++)
+			rtn = restored.update(message[i]);
+		REQUIRE(rtn.res == ParseResult::RECEIVED_CMD_WRITE);
+		REQUIRE(std::memcmp(restored.data(), "Hello world, goodbye world!",
+							std::strlen("Hello world, goodbye world!")) == 0);
+	}
+}
+
+TEST_CASE("Parser snapshots preserve CMD EXT_MODE offsets",
+		  "[Parser] [Snapshot] [CMD_EXT_MODE]") {
+	std::array<uint8_t, 3> ext_mode {
+		(static_cast<uint8_t>(Magics::CMD::CMD_BASE) | CMD_EXT_MODE), 0x08
+	};
+	ext_mode[2] = Framing::checksum(ext_mode.data(), 2);
+	std::array<uint8_t, Framing::BUFFER_MIN> select { };
+	const uint8_t select_size {
+		Framing::frame_cmd_select_message(select.data(), 0x03)
+	};
+
+	Parser p { };
+	for (const uint8_t b : ext_mode)
+		p.update(b);
+	std::array<uint8_t, SNAPSHOT_MAX_LEN> snapshot { };
+	p.snapshot(snapshot.data());
+
+	Parser restored { };
+	REQUIRE(restored.restore(snapshot.data(), snapshot.size()) > 0);
+	ParserReturn rtn { };
+	for (uint8_t i = 0; i < select_size; i++)
+		rtn = restored.update(select[i]);
+	REQUIRE(rtn.res == ParseResult::RECEIVED_CMD_SELECT);
+	REQUIRE(restored.selected_mode() == 0x0b);
+}
+
+TEST_CASE("Snapshots of many parsers are taken and restored in bulk",
+		  "[Parser] [Snapshot]") {
+	constexpr size_t parser_count { 1000 };
+	std::array<uint8_t, Framing::BUFFER_MIN> message { };
+	const uint8_t message_size {
+		Framing::frame_cmd_write_message(message.data(),
+		reinterpret_cast<const uint8_t*>("Goodbye"), std::strlen("Goodbye"))
+	};
+
+	// Every parser is at a different point within the message
+	std::unique_ptr<Parser[]> parsers { new Parser[parser_count] };
+	for (size_t i = 0; i < parser_count; i++)
+		for (size_t j = 0; j < (i % message_size); j++)
+			parsers[i].update(message[j]);
+
+	std::vector<uint8_t> snapshots(parser_count * SNAPSHOT_MAX_LEN);
+	const size_t snapshots_size {
+		snapshot(parsers.get(), parser_count, snapshots.data())
+	};
+	REQUIRE(snapshots_size > 0);
+
+	std::unique_ptr<Parser[]> restored { new Parser[parser_count] };
+	REQUIRE(restore(restored.get(), parser_count, snapshots.data(),
+					snapshots_size) == snapshots_size);
+
+	for (size_t i = 0; i < parser_count; i++) {
+		ParserReturn rtn { };
+		for (size_t j = (i % message_size); j < message_size; j++)
+			rtn = restored[i].update(message[j]);
+		REQUIRE(rtn.res == ParseResult::RECEIVED_CMD_WRITE);
+	}
+
+	SECTION("Truncated bulk snapshots are rejected") {
+		REQUIRE(restore(restored.get(), parser_count, snapshots.data(),
+						snapshots_size - 1) == 0);
+	}
+}
+
+TEST_CASE("Parser rejects invalid snapshots", "[Parser] [Snapshot]") {
+	std::array<uint8_t, Framing::BUFFER_MIN> message { };
+	Framing::frame_cmd_write_message(message.data(),
+		reinterpret_cast<const uint8_t*>("Goodbye"), std::strlen("Goodbye"));
+
+	Parser p { };
+	for (uint8_t i = 0; i < 4; i++)
+		p.update(message[i]);
+	std::array<uint8_t, SNAPSHOT_MAX_LEN> snapshot { };
+	const uint8_t snapshot_size { p.snapshot(snapshot.data()) };
+
+	Parser restored { };
+	SECTION("Truncated snapshots are rejected") {
+		for (uint8_t len = 0; len < snapshot_size; len++)
+			REQUIRE(restored.restore(snapshot.data(), len) == 0);
+	}
+	SECTION("Snapshots of other versions are rejected") {
+		snapshot[0] = SNAPSHOT_VERSION + 1;
+		REQUIRE(restored.restore(snapshot.data(), snapshot_size) == 0);
+	}
+	SECTION("Snapshots with invalid states are rejected") {
+		snapshot[1] = 0x02;
+		REQUIRE(restored.restore(snapshot.data(), snapshot_size) == 0);
+	}
+	SECTION("Snapshots with inconsistent lengths are rejected") {
+		snapshot[3] = snapshot[2] + 2;
+		REQUIRE(restored.restore(snapshot.data(), snapshot_size) == 0);
+	}
+	SECTION("Snapshots with invalid header bytes are rejected") {
+		// CMD SELECT header, not matching the payload length
+		snapshot[SNAPSHOT_HEADER_LEN] =
+			(static_cast<uint8_t>(Magics::CMD::CMD_BASE)
+			 | static_cast<uint8_t>(Magics::CMD::SELECT));
+		REQUIRE(restored.restore(snapshot.data(), snapshot_size) == 0);
+	}
+	SECTION("Snapshots of SYS messages being received are rejected") {
+		// SYS ACK header, with no payload and only the FCS byte pending
+		const uint8_t sys[SNAPSHOT_HEADER_LEN + 1] {
+			SNAPSHOT_VERSION, static_cast<uint8_t>(State::WAIT_CHECKSUM),
+			0x00, 0x01, 0x00, static_cast<uint8_t>(Magics::SYS::ACK)
+		};
+		REQUIRE(restored.restore(sys, sizeof(sys)) == 0);
+	}
+	// Restored parser must still be waiting for a header byte
+	REQUIRE(restored.update(static_cast<uint8_t>(Magics::CMD::CMD_BASE)
+							| static_cast<uint8_t>(Magics::CMD::TYPE)).res
+			== ParseResult::RECEIVED_INVALID_HEADER);
+}
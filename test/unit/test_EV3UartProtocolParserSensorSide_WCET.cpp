@@ -0,0 +1,335 @@
+/**
+ * \file test_EV3UartProtocolParserSensorSide_WCET.cpp
+ *
+ * Worst-case execution time harness for Parser::update()
+ *
+ * The harness drives the parser through every state and transition it can
+ * take on a single byte, and through every message it can complete from a
+ * block, times each call to Parser::update(uint8_t) and
+ * Parser::update(const uint8_t*, size_t, ParserReturn&) on its own, and
+ * reports the cost of each path, and the worst path overall. The results
+ * of every timed call are checked as well.
+ *
+ * Paths covered:
+ * - Every header byte, in State::WAIT_HEADER, i.e. invalid header floods,
+ *   SYS messages and the start of every CMD message
+ * - Every payload byte of CMD WRITE messages of every length
+ * - The FCS byte of every CMD message, with good and invalid FCS,
+ *   including the 32 byte CMD WRITE message
+ * - The FCS byte of CMD SELECT and CMD WRITE messages following a
+ *   CMD EXT_MODE message, which apply its offset
+ * - Blocks holding a whole CMD WRITE message of every length, with good and
+ *   invalid FCS, and blocks holding the rest of the message after its
+ *   header byte
+ *
+ * Costs are in TSC cycles on x86, and in \c std::chrono::steady_clock ticks
+ * elsewhere, and include the overhead of reading the counter. Paths are
+ * ranked by the largest cost observed over all calls, which bounds the
+ * WCET. On a host, it also includes interrupts, preemption and cache
+ * misses, so the harness should be run on an isolated core.
+ *
+ * To tell such outliers apart from the cost of the path itself, the calls
+ * are timed in \ref BATCHES batches, and the smallest of the per-batch
+ * maxima of each transition, i.e. the worst cost it reproduces in every
+ * batch, is reported alongside, as "min batch max". It is not a WCET
+ * bound. The smallest cost observed is reported as well.
+ *
+ * The harness is hidden, as its results depend on the host. Run it with:
+ * \code
+ * tests [wcet]
+ * \endcode
+ * If the \c EV3UART_WCET_BUDGET environment variable is set, the harness
+ * fails if the largest cost observed on any path is more than that many
+ * counter units, so that changes raising the WCET can be caught on a fixed
+ * build host.
+ *
+ * \copyright Shenghao Yang, 2018
+ *
+ * See LICENSE for details
+ */
+
+#include <EV3UartProtocolParserSensorSide.hpp>
+#include <EV3UartGenerator.hpp>
+#include "catch.hpp"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <string>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+using namespace EV3UartGenerator;
+using namespace EV3UartProtocolParserSensorSide;
+
+namespace {
+
+/**
+ * Number of batches the calls of every path are split into
+ */
+constexpr size_t BATCHES { 10 };
+
+/**
+ * Number of times every path is timed in each batch
+ */
+constexpr size_t ROUNDS { 50 };
+
+/**
+ * Read the cycle counter, serialized against the code around it
+ */
+inline uint64_t timestamp() {
+#if defined(__x86_64__) || defined(__i386__)
+	_mm_lfence();
+	const uint64_t t { __rdtsc() };
+	_mm_lfence();
+	return t;
+#else
+	return static_cast<uint64_t>(
+			std::chrono::steady_clock::now().time_since_epoch().count());
+#endif
+}
+
+const char* result_name(ParseResult res) {
+	switch (res) {
+	case ParseResult::INSUFFICIENT_DATA:
+		return "INSUFFICIENT_DATA";
+	case ParseResult::RECEIVED_INVALID_HEADER:
+		return "RECEIVED_INVALID_HEADER";
+	case ParseResult::RECEIVED_SYS_ACK:
+		return "RECEIVED_SYS_ACK";
+	case ParseResult::RECEIVED_SYS_NACK:
+		return "RECEIVED_SYS_NACK";
+	case ParseResult::RECEIVED_CMD_SELECT:
+		return "RECEIVED_CMD_SELECT";
+	case ParseResult::RECEIVED_CMD_WRITE:
+		return "RECEIVED_CMD_WRITE";
+	case ParseResult::RECEIVED_CMD_SPEED:
+		return "RECEIVED_CMD_SPEED";
+	case ParseResult::RECEIVED_CMD_EXT_MODE:
+		return "RECEIVED_CMD_EXT_MODE";
+	case ParseResult::RECEIVED_CMD_INVALID_FCS:
+		return "RECEIVED_CMD_INVALID_FCS";
+	}
+	return "?";
+}
+
+/**
+ * Transition of the parser: bytes bringing the parser into the starting
+ * state, untimed, followed by the bytes timed, input in a single call
+ */
+struct Transition {
+	std::string path;
+	std::vector<uint8_t> setup;
+	std::vector<uint8_t> input;
+	/**
+	 * \c true to input the bytes timed as a block, \c false to input the
+	 * single byte timed on its own
+	 */
+	bool block;
+	ParseResult expected;
+};
+
+/**
+ * Costs observed on a path
+ */
+struct PathCost {
+	std::string path;
+	/**
+	 * Largest of the minima of the per-batch maxima of the transitions on
+	 * the path
+	 */
+	uint64_t min_batch_max;
+	uint64_t max;
+	uint64_t min;
+	size_t calls;
+};
+
+std::vector<uint8_t> framed(uint8_t* buffer, int8_t len) {
+	return std::vector<uint8_t>(buffer, buffer + len);
+}
+
+/**
+ * Add the transitions of every byte of a CMD message after the header byte
+ */
+void add_message(std::vector<Transition>& transitions,
+				 const std::string& name, const std::vector<uint8_t>& prefix,
+				 const std::vector<uint8_t>& msg, ParseResult expected) {
+	for (size_t i = 1; i < msg.size(); i++) {
+		std::vector<uint8_t> setup { prefix };
+		setup.insert(setup.end(), msg.begin(), msg.begin() + i);
+		const bool last { i == (msg.size() - 1) };
+		transitions.push_back(Transition {
+			last ? (name + " FCS byte") : (name + " payload byte"),
+			setup, { msg[i] }, false,
+			last ? expected : ParseResult::INSUFFICIENT_DATA
+		});
+	}
+
+	// Same message with invalid FCS
+	std::vector<uint8_t> setup { prefix };
+	setup.insert(setup.end(), msg.begin(), msg.end() - 1);
+	transitions.push_back(Transition {
+		name + " invalid FCS byte", setup,
+		{ static_cast<uint8_t>(msg.back() ^ 0x01) }, false,
+		ParseResult::RECEIVED_CMD_INVALID_FCS
+	});
+}
+
+/**
+ * Add the transitions of blocks holding a CMD message, whole or after the
+ * header byte
+ */
+void add_block(std::vector<Transition>& transitions, const std::string& name,
+			   const std::vector<uint8_t>& msg, ParseResult expected) {
+	std::vector<uint8_t> invalid { msg };
+	invalid.back() ^= 0x01;
+
+	transitions.push_back(Transition {
+		"block " + name, { }, msg, true, expected
+	});
+	transitions.push_back(Transition {
+		"block " + name + " invalid FCS", { }, invalid, true,
+		ParseResult::RECEIVED_CMD_INVALID_FCS
+	});
+	transitions.push_back(Transition {
+		"block " + name + " after header byte", { msg.front() },
+		std::vector<uint8_t>(msg.begin() + 1, msg.end()), true, expected
+	});
+}
+
+std::vector<Transition> transitions() {
+	std::vector<Transition> all { };
+	std::array<uint8_t, Framing::BUFFER_MIN> buffer;
+
+	// Header bytes, from a parser waiting for a header byte
+	for (uint16_t hdr = 0; hdr < 0x100; hdr++) {
+		Parser p { };
+		const ParseResult res { p.update(static_cast<uint8_t>(hdr)).res };
+		all.push_back(Transition {
+			std::string { "header byte -> " } + result_name(res), { },
+			{ static_cast<uint8_t>(hdr) }, false, res
+		});
+	}
+
+	// CMD WRITE messages of every length
+	for (uint8_t code = 0; code < 6; code++) {
+		std::vector<uint8_t> payload(two_pow(code));
+		std::iota(payload.begin(), payload.end(), 0x00);
+		const std::vector<uint8_t> msg { framed(buffer.data(),
+			Framing::frame_cmd_write_message(buffer.data(), payload.data(),
+											 payload.size())) };
+		add_message(all, "CMD WRITE " + std::to_string(payload.size()), { },
+					msg, ParseResult::RECEIVED_CMD_WRITE);
+		add_block(all, "CMD WRITE " + std::to_string(payload.size()), msg,
+				  ParseResult::RECEIVED_CMD_WRITE);
+	}
+
+	const std::vector<uint8_t> select { framed(buffer.data(),
+		Framing::frame_cmd_select_message(buffer.data(), 0x05)) };
+	add_message(all, "CMD SELECT", { }, select,
+				ParseResult::RECEIVED_CMD_SELECT);
+
+	add_message(all, "CMD SPEED", { }, framed(buffer.data(),
+				Framing::frame_cmd_speed_message(buffer.data(), 57600)),
+				ParseResult::RECEIVED_CMD_SPEED);
+
+	std::vector<uint8_t> ext_mode {
+		static_cast<uint8_t>(static_cast<uint8_t>(Magics::CMD::CMD_BASE)
+							 | CMD_EXT_MODE), 0x08
+	};
+	ext_mode.push_back(Framing::checksum(ext_mode.data(), ext_mode.size()));
+	add_message(all, "CMD EXT_MODE", { }, ext_mode,
+				ParseResult::RECEIVED_CMD_EXT_MODE);
+
+	// Messages applying the offset of a CMD EXT_MODE message
+	add_message(all, "CMD SELECT after CMD EXT_MODE", ext_mode, select,
+				ParseResult::RECEIVED_CMD_SELECT);
+	std::vector<uint8_t> payload(0x20, 0xa5);
+	add_message(all, "CMD WRITE 32 after CMD EXT_MODE", ext_mode,
+				framed(buffer.data(), Framing::frame_cmd_write_message(
+						buffer.data(), payload.data(), payload.size())),
+				ParseResult::RECEIVED_CMD_WRITE);
+
+	return all;
+}
+}
+
+TEST_CASE("Parser::update() worst-case execution time", "[.] [wcet]") {
+	const std::vector<Transition> all { transitions() };
+	std::vector<PathCost> costs { };
+	// Smallest of the per-batch maxima of each transition
+	std::vector<uint64_t> min_batch_max(all.size(), UINT64_MAX);
+
+	for (size_t batch = 0; batch < BATCHES; batch++) {
+		std::vector<uint64_t> batch_max(all.size(), 0);
+
+		for (size_t round = 0; round < ROUNDS; round++) {
+			for (size_t i = 0; i < all.size(); i++) {
+				const Transition& t { all[i] };
+				Parser p { };
+				for (const uint8_t b : t.setup)
+					p.update(b);
+
+				ParserReturn rtn { };
+				size_t consumed { 1 };
+				const uint64_t start { timestamp() };
+				if (t.block)
+					consumed = p.update(t.input.data(), t.input.size(), rtn);
+				else
+					rtn = p.update(t.input.front());
+				const uint64_t cost { timestamp() - start };
+
+				CAPTURE(t.path);
+				REQUIRE(rtn.res == t.expected);
+				REQUIRE(consumed == t.input.size());
+
+				batch_max[i] = std::max(batch_max[i], cost);
+				auto it = std::find_if(costs.begin(), costs.end(),
+						[&t](const PathCost& c) { return c.path == t.path; });
+				if (it == costs.end()) {
+					costs.push_back(PathCost { t.path, 0, cost, cost, 1 });
+				} else {
+					it->max = std::max(it->max, cost);
+					it->min = std::min(it->min, cost);
+					it->calls += 1;
+				}
+			}
+		}
+
+		for (size_t i = 0; i < all.size(); i++)
+			min_batch_max[i] = std::min(min_batch_max[i], batch_max[i]);
+	}
+
+	for (size_t i = 0; i < all.size(); i++) {
+		auto it = std::find_if(costs.begin(), costs.end(),
+				[&all, i](const PathCost& c) { return c.path == all[i].path; });
+		it->min_batch_max = std::max(it->min_batch_max, min_batch_max[i]);
+	}
+
+	std::sort(costs.begin(), costs.end(),
+			  [](const PathCost& a, const PathCost& b) { return a.max > b.max; });
+
+	std::cout << std::left << std::setw(48) << "path"
+			  << std::right << std::setw(10) << "calls"
+			  << std::setw(10) << "min" << std::setw(16) << "min batch max"
+			  << std::setw(10) << "max" << '\n';
+	for (const PathCost& c : costs)
+		std::cout << std::left << std::setw(48) << c.path
+				  << std::right << std::setw(10) << c.calls
+				  << std::setw(10) << c.min << std::setw(16) << c.min_batch_max
+				  << std::setw(10) << c.max << '\n';
+	std::cout << "worst path: " << costs.front().path << " ("
+			  << costs.front().max << ")" << std::endl;
+
+	const char* budget { std::getenv("EV3UART_WCET_BUDGET") };
+	if (budget) {
+		CAPTURE(costs.front().path);
+		REQUIRE(costs.front().max <= std::strtoull(budget, nullptr, 10));
+	}
+}
@@ -0,0 +1,106 @@
+/**
+ * \file test_EV3UartSniffer.cpp
+ *
+ * Unit tests for functionality contained in EV3UartSniffer.cpp
+ *
+ * The tests in this file verify that the sniffer:
+ * - Decodes both directions of a connection
+ * - Measures the latency between SYS NACK messages and their replies
+ *
+ * \copyright Shenghao Yang, 2018
+ *
+ * See LICENSE for details
+ */
+
+#include <EV3UartSniffer.hpp>
+#include <EV3UartGenerator.hpp>
+#include "catch.hpp"
+#include <vector>
+
+using namespace EV3UartGenerator;
+using namespace EV3UartProtocolParserSensorSide;
+
+namespace {
+
+const uint8_t NACK { static_cast<uint8_t>(Magics::SYS::NACK) };
+
+/**
+ * DATA message for mode 0 with a 1 byte payload
+ */
+std::vector<uint8_t> data_message(uint8_t value) {
+	std::vector<uint8_t> msg {
+		static_cast<uint8_t>(Magics::DATA::DATA_BASE), value
+	};
+	msg.push_back(Framing::checksum(msg.data(), msg.size()));
+	return msg;
+}
+
+/**
+ * Feed a message from the sensor to the sniffer, returning the last result
+ */
+HostParserReturn from_sensor(Sniffer& s, const std::vector<uint8_t>& msg,
+							 uint32_t now) {
+	HostParserReturn rtn { };
+	size_t offset { 0 };
+	while (offset < msg.size())
+		offset += s.update_from_sensor(msg.data() + offset,
+									   msg.size() - offset, now, rtn);
+	return rtn;
+}
+}
+
+TEST_CASE("Sniffer measures SYS NACK to DATA latency", "[Sniffer]") {
+	Sniffer s { };
+	ParserReturn ev3_rtn { };
+
+	SECTION("Replies are matched to the last SYS NACK message") {
+		REQUIRE(s.update_from_ev3(&NACK, 1, 100, ev3_rtn) == 1);
+		REQUIRE(ev3_rtn.res == ParseResult::RECEIVED_SYS_NACK);
+		REQUIRE(from_sensor(s, data_message(7), 103).res
+				== HostParseResult::RECEIVED_DATA);
+		REQUIRE(s.sensor().data()[0] == 7);
+
+		// DATA messages sent without a SYS NACK message are not replies
+		from_sensor(s, data_message(8), 150);
+
+		s.update_from_ev3(&NACK, 1, 200, ev3_rtn);
+		from_sensor(s, data_message(9), 201);
+
+		REQUIRE(s.nack_latency().last == 1);
+		REQUIRE(s.nack_latency().max == 3);
+		REQUIRE(s.nack_latency().replies == 2);
+		REQUIRE(s.nack_latency().unanswered == 0);
+	}
+
+	SECTION("SYS NACK messages without replies are counted") {
+		s.update_from_ev3(&NACK, 1, 0, ev3_rtn);
+		s.update_from_ev3(&NACK, 1, 10, ev3_rtn);
+		from_sensor(s, data_message(1), 12);
+		REQUIRE(s.nack_latency().unanswered == 1);
+		REQUIRE(s.nack_latency().last == 2);
+	}
+
+	SECTION("Latency is measured across timestamp wrap around") {
+		s.update_from_ev3(&NACK, 1, 0xfffffffe, ev3_rtn);
+		from_sensor(s, data_message(1), 3);
+		REQUIRE(s.nack_latency().last == 5);
+	}
+
+	SECTION("Replies with invalid FCS are not matched") {
+		std::vector<uint8_t> damaged { data_message(1) };
+		damaged.back() ^= 0x01;
+		s.update_from_ev3(&NACK, 1, 0, ev3_rtn);
+		REQUIRE(from_sensor(s, damaged, 1).res
+				== HostParseResult::RECEIVED_INVALID_FCS);
+		from_sensor(s, data_message(1), 4);
+		REQUIRE(s.nack_latency().last == 4);
+		REQUIRE(s.nack_latency().replies == 1);
+	}
+
+	SECTION("Resetting the sniffer clears the statistics") {
+		s.update_from_ev3(&NACK, 1, 0, ev3_rtn);
+		s.reset();
+		from_sensor(s, data_message(1), 4);
+		REQUIRE(s.nack_latency().replies == 0);
+	}
+}
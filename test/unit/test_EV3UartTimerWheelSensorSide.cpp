@@ -0,0 +1,264 @@
+/**
+ * \file test_EV3UartTimerWheelSensorSide.cpp
+ *
+ * Unit tests for functionality contained in EV3UartTimerWheelSensorSide.cpp
+ *
+ * The tests in this file verify that the timer wheel:
+ * - Expires timers exactly at their deadlines, within and beyond the span
+ *   of the wheel and across timestamp wrap around
+ * - Does not expire cancelled or re-armed timers at their old deadlines
+ * - Allows callbacks to arm and cancel timers
+ * - Drives inter-byte timeouts of a bank of parsers
+ *
+ * \copyright Shenghao Yang, 2018
+ *
+ * See LICENSE for details
+ */
+
+#include <EV3UartTimerWheelSensorSide.hpp>
+#include <EV3UartProtocolParserSensorSide.hpp>
+#include <EV3UartGenerator.hpp>
+#include "catch.hpp"
+#include <vector>
+#include <random>
+
+using namespace EV3UartGenerator;
+using namespace EV3UartProtocolParserSensorSide;
+
+namespace {
+
+/**
+ * Timer recording the ticks it expired at
+ */
+struct RecordingTimer {
+	TimerNode node { };
+	TimerWheel* wheel { nullptr };
+	std::vector<uint32_t> expiries { };
+	/**
+	 * Period to re-arm the timer with on expiry, \c 0 to not re-arm
+	 */
+	uint32_t period { 0 };
+	/**
+	 * Timer to cancel on expiry
+	 */
+	TimerNode* victim { nullptr };
+};
+
+void record_expiry(void* context, TimerNode& node) {
+	RecordingTimer& t { *static_cast<RecordingTimer*>(context) };
+	REQUIRE(!node.armed());
+	t.expiries.push_back(t.wheel->now());
+	if (t.period)
+		t.wheel->arm(node, t.wheel->now() + t.period);
+	if (t.victim)
+		t.wheel->cancel(*t.victim);
+}
+
+void setup(RecordingTimer& t, TimerWheel& wheel) {
+	t.wheel = &wheel;
+	t.node.callback = record_expiry;
+	t.node.context = &t;
+}
+}
+
+TEST_CASE("TimerWheel expires timers at their deadlines", "[TimerWheel]") {
+	const std::vector<uint32_t> starts { 0, 0xfffff000u, 0x12345 };
+	const std::vector<uint32_t> delays {
+		1, 2, 255, 256, 257, 1000, TIMER_WHEEL_SPAN - 1, TIMER_WHEEL_SPAN,
+		TIMER_WHEEL_SPAN + 1, 3 * TIMER_WHEEL_SPAN + 77,
+	};
+
+	for (const uint32_t start : starts) {
+		TimerWheel wheel { start };
+		std::vector<RecordingTimer> timers(delays.size());
+
+		for (size_t i = 0; i < delays.size(); i++) {
+			setup(timers[i], wheel);
+			wheel.arm(timers[i].node, start + delays[i]);
+		}
+
+		// Advance in irregular steps
+		uint32_t now { start };
+		size_t expired { 0 };
+		for (uint32_t step = 1; (now - start) < (4 * TIMER_WHEEL_SPAN);
+			 step = (step * 7 + 3) % 701 + 1) {
+			now += step;
+			expired += wheel.advance(now);
+		}
+
+		CAPTURE(start);
+		REQUIRE(expired == delays.size());
+		for (size_t i = 0; i < delays.size(); i++) {
+			CAPTURE(delays[i]);
+			REQUIRE(timers[i].expiries
+					== std::vector<uint32_t> { start + delays[i] });
+		}
+	}
+}
+
+TEST_CASE("TimerWheel expires overdue timers on the next tick",
+		  "[TimerWheel]") {
+	TimerWheel wheel { 100 };
+	RecordingTimer t { };
+	setup(t, wheel);
+
+	wheel.arm(t.node, 100);
+	REQUIRE(wheel.advance(100) == 0);
+	REQUIRE(wheel.advance(101) == 1);
+	REQUIRE(t.expiries == std::vector<uint32_t> { 101 });
+
+	wheel.arm(t.node, 50);
+	REQUIRE(wheel.advance(105) == 1);
+	REQUIRE(t.expiries.back() == 102);
+}
+
+TEST_CASE("TimerWheel cancels and re-arms timers", "[TimerWheel]") {
+	TimerWheel wheel { 0 };
+	RecordingTimer a { };
+	RecordingTimer b { };
+	setup(a, wheel);
+	setup(b, wheel);
+
+	SECTION("Cancelled timers do not expire") {
+		wheel.arm(a.node, 10);
+		wheel.arm(b.node, 300);
+		wheel.cancel(a.node);
+		wheel.cancel(b.node);
+		wheel.cancel(b.node);
+		REQUIRE_FALSE(a.node.armed());
+		REQUIRE(wheel.advance(1000) == 0);
+	}
+
+	SECTION("Re-armed timers expire at their new deadlines") {
+		wheel.arm(a.node, 10);
+		wheel.arm(a.node, 20);
+		wheel.arm(b.node, 600);
+		wheel.arm(b.node, 5);
+		REQUIRE(wheel.advance(1000) == 2);
+		REQUIRE(a.expiries == std::vector<uint32_t> { 20 });
+		REQUIRE(b.expiries == std::vector<uint32_t> { 5 });
+	}
+
+	SECTION("Callbacks can re-arm their own timers") {
+		a.period = 100;
+		wheel.arm(a.node, 100);
+		REQUIRE(wheel.advance(1000) == 10);
+		REQUIRE(a.expiries.back() == 1000);
+		REQUIRE(a.node.armed());
+	}
+
+	SECTION("Callbacks can cancel timers due at the same tick") {
+		wheel.arm(a.node, 10);
+		wheel.arm(b.node, 10);
+		// Whichever expires first cancels the other
+		a.victim = &b.node;
+		b.victim = &a.node;
+		REQUIRE(wheel.advance(10) == 1);
+		REQUIRE((a.expiries.size() + b.expiries.size()) == 1);
+	}
+}
+
+TEST_CASE("TimerWheel matches a reference model", "[TimerWheel]") {
+	std::mt19937 rng { 1234 };
+	const uint32_t start { 0xffff0000u };
+	TimerWheel wheel { start };
+	std::vector<RecordingTimer> timers(200);
+	std::vector<bool> armed(timers.size(), false);
+	std::vector<uint32_t> deadlines(timers.size(), 0);
+	std::vector<size_t> expected_counts(timers.size(), 0);
+
+	for (auto& t : timers)
+		setup(t, wheel);
+
+	uint32_t now { start };
+	for (uint16_t round = 0; round < 2000; round++) {
+		const size_t i { rng() % timers.size() };
+		switch (rng() % 3) {
+		case 0:
+			deadlines[i] = now + (rng() % (2 * TIMER_WHEEL_SPAN));
+			wheel.arm(timers[i].node, deadlines[i]);
+			armed[i] = true;
+			break;
+		case 1:
+			wheel.cancel(timers[i].node);
+			armed[i] = false;
+			break;
+		default:
+			break;
+		}
+
+		const uint32_t next { now + (rng() % 64) };
+		for (size_t j = 0; j < timers.size(); j++) {
+			// Overdue timers expire on the next tick
+			const uint32_t due { (static_cast<int32_t>(deadlines[j] - now) > 0)
+								 ? deadlines[j] : now + 1 };
+			if (armed[j] && (static_cast<int32_t>(next - due) >= 0)) {
+				armed[j] = false;
+				expected_counts[j] += 1;
+			}
+		}
+		wheel.advance(next);
+		now = next;
+
+		for (size_t j = 0; j < timers.size(); j++) {
+			CAPTURE(round);
+			CAPTURE(j);
+			REQUIRE(timers[j].expiries.size() == expected_counts[j]);
+			REQUIRE(timers[j].node.armed() == armed[j]);
+		}
+	}
+}
+
+TEST_CASE("TimerWheel drives inter-byte timeouts of a bank of parsers",
+		  "[TimerWheel]") {
+	constexpr size_t ports { 2000 };
+	constexpr uint32_t inter_byte_timeout { 5 };
+
+	struct Port {
+		Parser parser;
+		TimerNode inter_byte;
+		bool timed_out;
+	};
+	std::vector<Port> bank(ports);
+
+	TimerWheel wheel { 0 };
+	for (Port& port : bank) {
+		port.inter_byte.callback = [](void* context, TimerNode&) {
+			Port& p { *static_cast<Port*>(context) };
+			p.timed_out = p.parser.line_event(LineEvent::TIMEOUT);
+		};
+		port.inter_byte.context = &port;
+		port.timed_out = false;
+	}
+
+	// Every even port receives the start of a CMD SELECT message
+	uint8_t select[Framing::BUFFER_MIN];
+	Framing::frame_cmd_select_message(select, 2);
+	for (size_t i = 0; i < ports; i += 2) {
+		REQUIRE(bank[i].parser.update(select[0]).res
+				== ParseResult::INSUFFICIENT_DATA);
+		wheel.arm(bank[i].inter_byte, inter_byte_timeout);
+	}
+
+	// Only the ports that were not completed in time time out
+	for (size_t i = 0; i < ports; i += 4) {
+		bank[i].parser.update(select[1]);
+		REQUIRE(bank[i].parser.update(select[2]).res
+				== ParseResult::RECEIVED_CMD_SELECT);
+		wheel.cancel(bank[i].inter_byte);
+	}
+
+	REQUIRE(wheel.advance(inter_byte_timeout - 1) == 0);
+	REQUIRE(wheel.advance(inter_byte_timeout) == (ports / 4));
+	for (size_t i = 0; i < ports; i++) {
+		CAPTURE(i);
+		REQUIRE(bank[i].timed_out == ((i % 4) == 2));
+	}
+
+	// The timed out parsers are ready to parse a new message
+	REQUIRE(bank[2].parser.update(select[0]).res
+			== ParseResult::INSUFFICIENT_DATA);
+	bank[2].parser.update(select[1]);
+	REQUIRE(bank[2].parser.update(select[2]).res
+			== ParseResult::RECEIVED_CMD_SELECT);
+}